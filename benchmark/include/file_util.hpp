@@ -27,23 +27,17 @@
 #include <si_units.hpp>
 #include <limits>
 #include "ips4o.hpp"
+#include "common/alphabet.hpp"
+#include "common/text_reader.hpp"
 
 static uint8_t standardize(std::vector <uint8_t> &vector) {
-
-  std::vector<bool> char_occurs(256, false);
-  for (uint64_t i = 1; i < vector.size() - 1; ++i) {
-    char_occurs[vector[i]] = true;
-  }
-
-  uint64_t sigma = 0;
-  for (const auto b : char_occurs) {
-    sigma += b ? 1 : 0;
-  }
+  auto const alphabet =
+      gsaca_lyndon::detect_alphabet(vector.data(), vector.size());
+  uint64_t sigma = alphabet.sigma;
   std::cout << "[STANDARDIZE]         Alphabet size: sigma=" << sigma << "."
             << std::endl;
 
-  if (char_occurs[0]) {
-    uint64_t increase = 1;
+  if (alphabet.contains_zero()) {
     if (sigma == 256) {
       std::cerr << "[STANDARDIZE ERROR]   Cannot add sentinels (no unused "
                    "characters, sigma=256)."
@@ -56,45 +50,109 @@ static uint8_t standardize(std::vector <uint8_t> &vector) {
           << std::endl;
       sigma = 255;
     } else {
-      for (uint64_t i = 0; i < 256; ++i) {
-        if (!char_occurs[i]) {
-          increase = i;
-          break;
-        }
-      }
       std::cout << "[STANDARDIZE]         Text contains null-characters, but "
                    "does not contain the character "
-                << increase << "." << std::endl;
+                << alphabet.mex << "." << std::endl;
       std::cout << "[STANDARDIZE]         Incrementing all characters that are "
                    "smaller than "
-                << increase
+                << alphabet.mex
                 << ". This does not influence the resulting data structures."
                 << std::endl;
     }
-
-    for (auto &character : vector)
-      if (character < increase)
-        ++character;
   }
 
   std::cout
       << "[STANDARDIZE]         Adding sentinels at beginning and end of text."
       << std::endl;
-  vector[0] = '\0';
-  vector[vector.size() - 1] = '\0';
+  gsaca_lyndon::add_sentinels(vector.data(), vector.size(), alphabet);
   return sigma;
 }
 
-// adds sentinels
-static std::vector <uint8_t> file_to_instance(const std::string &file_name,
-                                              const uint64_t prefix_size,
-                                              uint8_t &sigma) {
+static std::ifstream open_instance(const std::string &file_name) {
   std::ifstream stream(file_name.c_str(), std::ios::in | std::ios::binary);
-
   if (!stream) {
     std::cerr << "File " << file_name << " not found.\n";
     exit(EXIT_FAILURE);
   }
+  return stream;
+}
+
+static void print_instance_size(const std::string &file_name,
+                                const uint64_t size_in_characters,
+                                const uint64_t bytes_per_char) {
+  std::cout << "Finished reading file \"" << file_name << "\"." << std::endl;
+  if (bytes_per_char == gsaca_lyndon::varint_bytes_per_char) {
+    std::cout << "Size (w/o sentinels): "
+              << "[" << size_in_characters << " characters] (varints)"
+              << std::endl;
+    return;
+  }
+  uint64_t const size_in_bytes = size_in_characters * bytes_per_char;
+  std::cout << "Size (w/o sentinels): "
+            << "[" << size_in_characters << " characters] = "
+            << ((size_in_bytes > 1023)
+                ? ("[" + std::to_string(size_in_bytes) + " bytes] = ")
+                : "")
+            << "[" << to_SI_string(size_in_bytes) << "]" << std::endl;
+}
+
+// Reads a file of integer symbols (bytes_per_char = 1, 2, 4, 8, or 0 for
+// varints, see common/text_reader.hpp) into the narrowest type that fits the
+// symbols, and calls f(text). The text has sentinel positions. The prefix
+// size is given in bytes of the file, except for varints (whose byte length
+// differs), where it is given in characters.
+template<typename function_type>
+static void read_instance(const std::string &file_name,
+                          const uint64_t prefix_size,
+                          const uint64_t bytes_per_char, function_type &&f) {
+  std::ifstream stream = open_instance(file_name);
+  bool const in_bytes = prefix_size > 0 &&
+      bytes_per_char != gsaca_lyndon::varint_bytes_per_char;
+  uint64_t const max_chars =
+      in_bytes ? std::max((uint64_t) 1, prefix_size / bytes_per_char)
+               : prefix_size;
+  try {
+    gsaca_lyndon::with_text(stream, bytes_per_char, max_chars,
+                            [&](auto &&text) {
+        print_instance_size(file_name, text.size() - 2, bytes_per_char);
+        f(text);
+    });
+  } catch (std::exception const &e) {
+    std::cerr << "Cannot read file " << file_name << ": " << e.what()
+              << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+// adds sentinels; symbols of more than one byte (see read_instance) are
+// mapped to their ranks, which only works for at most 255 distinct symbols
+static std::vector <uint8_t> file_to_instance(const std::string &file_name,
+                                              const uint64_t prefix_size,
+                                              uint8_t &sigma,
+                                              const uint64_t bytes_per_char) {
+  std::vector <uint8_t> result;
+  read_instance(file_name, prefix_size, bytes_per_char, [&](auto &text) {
+      gsaca_lyndon::with_compact_alphabet(text.data(), text.size(),
+                                          [&](auto const *const compact) {
+          if constexpr (sizeof(*compact) == 1) {
+            result.assign(compact, compact + text.size());
+          } else {
+            std::cerr << "The alphabet of " << file_name << " has more "
+                      << "than 255 symbols, use benchmark-large-alphabet."
+                      << std::endl;
+            exit(EXIT_FAILURE);
+          }
+      });
+  });
+  sigma = standardize(result);
+  return result;
+}
+
+// adds sentinels
+static std::vector <uint8_t> file_to_instance(const std::string &file_name,
+                                              const uint64_t prefix_size,
+                                              uint8_t &sigma) {
+  std::ifstream stream = open_instance(file_name);
 
   stream.seekg(0, std::ios::end);
   uint64_t size_in_characters = stream.tellg();
@@ -122,35 +180,54 @@ static std::vector <uint8_t> file_to_instance(const std::string &file_name,
   return result;
 }
 
-// Large Alphabets
+// Pseudo-random DNA-like text with long repeats (every fourth block of 1 MiB
+// is a copy of an earlier block). Useful for inputs that are larger than the
+// available files, e.g., texts of more than 2 GiB for 32-bit suffix arrays.
+static std::vector <uint8_t> synthetic_instance(
+    const uint64_t size_in_characters, uint8_t &sigma) {
+  constexpr uint64_t block = 1ULL << 20;
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  auto next = [&]() {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      return state;
+  };
 
-static uint32_t standardize(std::vector <uint32_t> &vector) {
-  // copy text to new vector
-  uint64_t n = vector.size();
-  std::vector<uint32_t> vector_copy(n-2);
-  std::copy(&(vector[1]), &(vector[n-1]), vector_copy.begin());
-
-  // sort characters
-  ips4o::parallel::sort(vector_copy.begin(), vector_copy.end());
-
-  // calculate sigma
-  uint32_t sigma = 1;
-  uint64_t increase = 1;
-  bool increase_found = false;
-  for (uint64_t i = 1; i < vector_copy.size(); ++i) {
-    if (vector_copy[i-1] != vector_copy[i])
-      ++sigma;
-    if (!increase_found && (vector_copy[i]-vector_copy[i-1] > 1)) {
-        increase = vector_copy[i-1]+1;
-        increase_found = true;
+  // +2 sentinels
+  std::vector <uint8_t> result(size_in_characters + 2);
+  for (uint64_t begin = 1; begin <= size_in_characters; begin += block) {
+    uint64_t const end = std::min(begin + block, size_in_characters + 1);
+    if (begin > block && (next() & 3) == 0) {
+      uint64_t const source = 1 + (next() % ((begin - 1) / block)) * block;
+      std::copy(&(result[source]), &(result[source + (end - begin)]),
+                &(result[begin]));
+    } else {
+      for (uint64_t i = begin; i < end; ++i) {
+        result[i] = "ACGT"[next() & 3];
+      }
     }
   }
 
+  std::cout << "Generated synthetic text." << std::endl;
+  std::cout << "Size (w/o sentinels): "
+            << "[" << size_in_characters << " characters] = "
+            << "[" << to_SI_string(size_in_characters) << "]" << std::endl;
+  sigma = standardize(result);
+  return result;
+}
+
+// Large Alphabets
+
+static uint32_t standardize(std::vector <uint32_t> &vector) {
+  auto const alphabet =
+      gsaca_lyndon::detect_alphabet(vector.data(), vector.size());
+  uint32_t sigma = alphabet.sigma;
   std::cout << "[STANDARDIZE]         Alphabet size: sigma=" << sigma << "."
             << std::endl;
 
-  if (vector_copy[0] == 0) {
-    if (sigma == std::numeric_limits<uint32_t>::max()) {
+  if (alphabet.contains_zero()) {
+    if (alphabet.mex > std::numeric_limits<uint32_t>::max()) {
       std::cerr << "[STANDARDIZE ERROR]   Cannot add sentinels (no unused "
                    "characters)."
                 << std::endl;
@@ -164,69 +241,41 @@ static uint32_t standardize(std::vector <uint32_t> &vector) {
     } else {
       std::cout << "[STANDARDIZE]         Text contains null-characters, but "
                    "does not contain the character "
-                << increase << "." << std::endl;
+                << alphabet.mex << "." << std::endl;
       std::cout << "[STANDARDIZE]         Incrementing all characters that are "
                    "smaller than "
-                << increase
+                << alphabet.mex
                 << ". This does not influence the resulting data structures."
                 << std::endl;
     }
-
-    for (auto &character : vector)
-      if (character < increase)
-        ++character;
   }
 
   std::cout
       << "[STANDARDIZE]         Adding sentinels at beginning and end of text."
       << std::endl;
-  vector[0] = 0;
-  vector[vector.size() - 1] = 0;
+  gsaca_lyndon::add_sentinels(vector.data(), vector.size(), alphabet);
   return sigma;
 }
 
-// adds sentinels
+// adds sentinels; the file consists of symbols of bytes_per_char bytes (see
+// read_instance), which have to fit into 32 bits
 static std::vector <uint32_t> file_to_instance(const std::string &file_name,
                                               const uint64_t prefix_size,
-                                              uint32_t &sigma) {
-  std::ifstream stream(file_name.c_str(), std::ios::in | std::ios::binary);
-
-  if (!stream) {
-    std::cerr << "File " << file_name << " not found.\n";
-    exit(EXIT_FAILURE);
-  }
-
-  stream.seekg(0, std::ios::end);
-  uint64_t size_in_bytes = stream.tellg();
-  stream.seekg(0);
-
-  if (prefix_size > 0) {
-    size_in_bytes = std::min(prefix_size, size_in_bytes);
-  }
-  uint64_t size_in_characters = size_in_bytes / sizeof(uint32_t);
-
-  // add bytes when text doesn't fit in uint32_t
-  uint64_t size_in_bytes_corrected = size_in_bytes;
-  uint8_t mod = size_in_bytes % 4;
-  if (mod > 0) {
-    ++size_in_characters;
-    size_in_bytes_corrected += (sizeof(uint32_t)-mod);
-  }
-
-  // +2 sentinels
-  std::vector <uint32_t> result(size_in_characters+2);
-  char *buffer = reinterpret_cast<char *>(result.data()+1);
-  //result.reserve(size_in_characters + 258);
-  stream.read(buffer, size_in_bytes);
-  stream.close();
-
-  std::cout << "Finished reading file \"" << file_name << "\"." << std::endl;
-  std::cout << "Size (w/o sentinels): "
-            << "[" << size_in_characters << " characters] = "
-            << ((size_in_bytes_corrected > 1023)
-                ? ("[" + std::to_string(size_in_bytes_corrected) + " bytes] = ")
-                : "")
-            << "[" << to_SI_string(size_in_bytes_corrected) << "]" << std::endl;
+                                              uint32_t &sigma,
+                                              const uint64_t bytes_per_char = 4) {
+  std::vector <uint32_t> result;
+  read_instance(file_name, prefix_size, bytes_per_char, [&](auto &text) {
+      using value_type = typename std::decay_t<decltype(text)>::value_type;
+      if constexpr (std::is_same_v<value_type, uint32_t>) {
+        result = std::move(text);
+      } else if constexpr (sizeof(value_type) < sizeof(uint32_t)) {
+        result.assign(text.begin(), text.end());
+      } else {
+        std::cerr << "The symbols of " << file_name << " do not fit into 32 "
+                  << "bits." << std::endl;
+        exit(EXIT_FAILURE);
+      }
+  });
   sigma = standardize(result);
   return result;
 }
@@ -3,6 +3,7 @@
 #include <gsaca-hash-ds.hpp>
 #include <gsaca-double-sort.hpp>
 #include <gsaca-double-sort-par.hpp>
+#include <gsaca-lyndon.hpp>
 #include <gsaca.h>
 #include <run_algorithm.hpp>
 #include <sstream>
@@ -13,7 +14,7 @@ using namespace gsaca_lyndon;
 
 struct {
   std::vector<std::string> file_paths;
-  uint64_t bytes_per_char = 1;
+  uint64_t bytes_per_char = 4;
   uint64_t number_of_runs = 5;
   uint64_t prefix_size = 0;
   std::string contains_all = "";
@@ -22,6 +23,7 @@ struct {
   std::string not_contains_any = "";
 
   std::string list_of_cores = "1,2,4,8,16";
+  std::string sort_config = "";
   bool list = false;
   bool check = false;
 
@@ -90,6 +92,65 @@ struct {
 
 } s;
 
+// no suffix for the default (MSD) configuration
+template<typename p1_sorter, typename p2_sorter>
+std::string sorter_suffix() {
+  if constexpr (std::is_same_v<p1_sorter, MSD> &&
+                std::is_same_v<p2_sorter, MSD>) {
+    return "";
+  } else if constexpr (std::is_same_v<p1_sorter, p2_sorter>) {
+    return "-" + p1_sorter::id();
+  } else {
+    return "-" + p1_sorter::id() + "-" + p2_sorter::id();
+  }
+}
+
+// gsaca_ds for the text with compacted alphabet (see with_compact_alphabet)
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_ds1_compact(value_type const *const text,
+                              index_type *const sa, size_t const n) {
+  with_compact_alphabet(text, n, [&](auto const *const compact) {
+      gsaca_ds<p1_sorter, p2_sorter>(compact, sa, n, 1);
+  }, 1);
+}
+
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_ds2_compact(value_type const *const text,
+                              index_type *const sa, size_t const n) {
+  with_compact_alphabet(text, n, [&](auto const *const compact) {
+      gsaca_ds<p1_sorter, p2_sorter>(compact, sa, n, 2);
+  }, 1);
+}
+
+template<typename index_type, typename value_type>
+static void gsaca_ds1_compact_par(value_type const *const text,
+                                  index_type *const sa, size_t const n,
+                                  size_t const threads) {
+  with_compact_alphabet(text, n, [&](auto const *const compact) {
+      gsaca_ds1_par(compact, sa, n, threads);
+  }, threads);
+}
+
+// automatic choice of the algorithm (see build_sa)
+template<typename index_type, typename value_type>
+static void gsaca_auto(value_type const *const text, index_type *const sa,
+                       size_t const n) {
+  build_options options;
+  options.report = true;
+  build_sa(text, sa, n, options);
+}
+
+template<typename index_type, typename value_type>
+static void gsaca_auto_par(value_type const *const text, index_type *const sa,
+                           size_t const n, size_t const threads) {
+  build_options options;
+  options.threads = threads;
+  options.report = true;
+  build_sa(text, sa, n, options);
+}
+
 
 int main(int argc, char const *argv[]) {
   tlx::CmdlineParser cp;
@@ -101,7 +162,11 @@ int main(int argc, char const *argv[]) {
   cp.add_bytes('r', "runs", s.number_of_runs,
                "Number of repetitions of the algorithm (default = 5).");
   cp.add_bytes('l', "length", s.prefix_size,
-               "Length of the prefix of the text that should be considered.");
+               "Length of the prefix of the file that should be considered "
+               "(in bytes; in characters for varints).");
+  cp.add_bytes('\0', "bytes-per-char", s.bytes_per_char,
+               "Width of the characters in the file: 1, 2, 4 or 8 bytes, or 0 "
+               "for varints (default = 4).");
 
   cp.add_string('\0', "contains", s.contains_all, "Alias for --contains-all");
   cp.add_string('\0', "contains-any", s.contains_any,
@@ -124,6 +189,11 @@ int main(int argc, char const *argv[]) {
                 "OMP threads (multiple options possible; comma separated, e.g. "
                 "\"1,2,4,8\").");
 
+  cp.add_string('\0', "sort-config", s.sort_config,
+                "Load the thresholds of the adaptive sorter from the given "
+                "file. If the file does not exist, the thresholds are "
+                "calibrated and written to the file.");
+
   cp.add_flag('\0', "list", s.list, "List the available algorithms.");
   cp.add_flag('\0', "check", s.check,
               "Check the correctness against divsufsort.");
@@ -137,16 +207,35 @@ int main(int argc, char const *argv[]) {
     std::cout << "gsaca_ds1" << std::endl;
     std::cout << "gsaca_ds2" << std::endl;
     std::cout << "gsaca_ds3" << std::endl;
+    std::cout << "gsaca_ds1_compact" << std::endl;
+    std::cout << "gsaca_ds2_compact" << std::endl;
+    std::cout << "gsaca_auto" << std::endl;
+    std::cout << "gsaca_ds1-adaptive" << std::endl;
+    std::cout << "gsaca_ds2-adaptive" << std::endl;
+    std::cout << "gsaca_ds3-adaptive" << std::endl;
+    std::cout << "gsaca_ds2-msd-soa" << std::endl;
+    std::cout << "gsaca_ds2-msd-packed" << std::endl;
+    std::cout << "gsaca_ds2-lsd-soa" << std::endl;
+    std::cout << "gsaca_ds2-lsd-packed" << std::endl;
     std::cout << "gsaca_ds1_par" << std::endl;
     std::cout << "gsaca_ds2_par" << std::endl;
     std::cout << "gsaca_ds3_par" << std::endl;
+    std::cout << "gsaca_ds1_compact_par" << std::endl;
+    std::cout << "gsaca_auto_par" << std::endl;
     return 0;
   }
 
+  if (s.sort_config.size() > 0) {
+    adaptive_internal::config() =
+        adaptive_internal::load_or_calibrate(s.sort_config);
+    std::cout << "Adaptive sorter: " << adaptive_internal::config().to_string()
+              << std::endl;
+  }
+
   for (auto file : s.file_paths) {
     uint32_t sigma = 0;
     std::vector<uint32_t> text_vec =
-        file_to_instance(file, s.prefix_size, sigma);
+        file_to_instance(file, s.prefix_size, sigma, s.bytes_per_char);
     const std::string info =
         std::string("file=") + file + " sigma=" + std::to_string(sigma);
 
@@ -157,7 +246,8 @@ int main(int argc, char const *argv[]) {
 
 #define run_with_sorting_type(name, sa_type, p1_sort, p2_sort, text, n) \
     { \
-        std::string name_with_sa_type = std::string(#name) + "-sa" + \
+        std::string name_with_sa_type = std::string(#name) + \
+            sorter_suffix<p1_sort, p2_sort>() + "-sa" + \
             std::to_string(sizeof(sa_type) * 8); \
         if (s.matches(name_with_sa_type)) { \
           if (s.check) { \
@@ -210,28 +300,70 @@ int main(int argc, char const *argv[]) {
         } \
     }
 
+    run_with_sorting_type(gsaca_hash_ds, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash_ds, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash_ds, uint48_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash_ds, uint64_t, MSD, MSD, text, n)
+
     run_with_sorting_type(gsaca_ds1, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds1, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds1, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds1, uint64_t, MSD, MSD, text, n)
 
     run_with_sorting_type(gsaca_ds2, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds2, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds2, uint64_t, MSD, MSD, text, n)
 
     run_with_sorting_type(gsaca_ds3, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds3, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds3, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds3, uint64_t, MSD, MSD, text, n)
 
+    run_with_sorting_type(gsaca_ds1_compact, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds1_compact, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_compact, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_compact, uint40_t, MSD, MSD, text, n)
+
+    run_with_sorting_type(gsaca_ds1, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds1, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds3, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds3, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+
+    run_with_sorting_type(gsaca_ds2, uint32_t, MSD_SOA, MSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, MSD_SOA, MSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, MSD_PACKED, MSD_PACKED, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, MSD_PACKED, MSD_PACKED, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, LSD_SOA, LSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, LSD_SOA, LSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, LSD_PACKED, LSD_PACKED, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, LSD_PACKED, LSD_PACKED, text, n)
+
     run_parallel(gsaca_ds1_par, uint32_t, text, n)
     run_parallel(gsaca_ds1_par, uint40_t, text, n)
+    run_parallel(gsaca_ds1_par, uint48_t, text, n)
     run_parallel(gsaca_ds1_par, uint64_t, text, n)
 
     run_parallel(gsaca_ds2_par, uint32_t, text, n)
     run_parallel(gsaca_ds2_par, uint40_t, text, n)
+    run_parallel(gsaca_ds2_par, uint48_t, text, n)
     run_parallel(gsaca_ds2_par, uint64_t, text, n)
 
     run_parallel(gsaca_ds3_par, uint32_t, text, n)
     run_parallel(gsaca_ds3_par, uint40_t, text, n)
+    run_parallel(gsaca_ds3_par, uint48_t, text, n)
     run_parallel(gsaca_ds3_par, uint64_t, text, n)
+
+    run_parallel(gsaca_ds1_compact_par, uint32_t, text, n)
+    run_parallel(gsaca_ds1_compact_par, uint40_t, text, n)
+
+    run_without_sorting_type(gsaca_auto, uint32_t, text, n)
+    run_without_sorting_type(gsaca_auto, uint40_t, text, n)
+    run_without_sorting_type(gsaca_auto, uint64_t, text, n)
+    run_parallel(gsaca_auto_par, uint32_t, text, n)
+    run_parallel(gsaca_auto_par, uint40_t, text, n)
+    run_parallel(gsaca_auto_par, uint64_t, text, n)
   }
 }
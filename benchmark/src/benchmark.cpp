@@ -5,6 +5,9 @@
 #include <gsaca-hash-ds.hpp>
 #include <gsaca-double-sort.hpp>
 #include <gsaca-double-sort-par.hpp>
+#include <gsaca-double-sort-reduced.hpp>
+#include <gsaca-double-sort-stream.hpp>
+#include <gsaca-lyndon.hpp>
 #include <gsaca.h>
 #include <run_algorithm.hpp>
 #include <sstream>
@@ -18,12 +21,15 @@ struct {
   uint64_t bytes_per_char = 1;
   uint64_t number_of_runs = 5;
   uint64_t prefix_size = 0;
+  uint64_t synthetic_size = 0;
   std::string contains_all = "";
   std::string contains_any = "";
   std::string not_contains_all = "";
   std::string not_contains_any = "";
 
   std::string list_of_cores = "1,2,4,8,16";
+  std::string list_of_prefixes = "4,8,12,16";
+  std::string sort_config = "";
   bool list = false;
   bool check = false;
 
@@ -38,6 +44,17 @@ struct {
     return false;
   }
 
+  bool matches_prefix(const uint64_t prefix) const {
+    std::stringstream c(list_of_prefixes);
+    while (c.good()) {
+      std::string sub;
+      getline(c, sub, ',');
+      if (sub == std::to_string(prefix))
+        return true;
+    }
+    return false;
+  }
+
   bool matches(const std::string algo) const {
     if (contains_all.size() > 0) {
       std::stringstream c_all(contains_all);
@@ -92,6 +109,87 @@ struct {
 
 } s;
 
+// no suffix for the default (MSD) configuration
+template<typename p1_sorter, typename p2_sorter>
+std::string sorter_suffix() {
+  if constexpr (std::is_same_v<p1_sorter, MSD> &&
+                std::is_same_v<p2_sorter, MSD>) {
+    return "";
+  } else if constexpr (std::is_same_v<p1_sorter, p2_sorter>) {
+    return "-" + p1_sorter::id();
+  } else {
+    return "-" + p1_sorter::id() + "-" + p2_sorter::id();
+  }
+}
+
+// gsaca_hash_ds with Lyndon words of up to 12 or 16 characters hashed
+// (128-bit nano texts)
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_hash12_ds(value_type const *const text,
+                            index_type *const sa, size_t const n) {
+  gsaca_hash_ds<p1_sorter, p2_sorter, auto_buffer_type, flags_bitset, 12>(
+      text, sa, n);
+}
+
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_hash16_ds(value_type const *const text,
+                            index_type *const sa, size_t const n) {
+  gsaca_hash_ds<p1_sorter, p2_sorter, auto_buffer_type, flags_bitset, 16>(
+      text, sa, n);
+}
+
+// gsaca_ds2 with the flags in a separate bit vector (see flag_type_bitvector)
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_ds2_bitvector(value_type const *const text,
+                                index_type *const sa, size_t const n) {
+  gsaca_ds<p1_sorter, p2_sorter, auto_buffer_type, flags_bitvector>(
+      text, sa, n, 2);
+}
+
+template<typename index_type, typename value_type>
+static void gsaca_ds2_par_bitvector(value_type const *const text,
+                                    index_type *const sa, size_t const n,
+                                    size_t const threads) {
+  gsaca_ds_par<auto_buffer_type, flags_bitvector>(text, sa, n, threads, 2);
+}
+
+// gsaca_ds2 reading the text (without sentinels) through an iterator
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_ds2_stream(value_type const *const text,
+                             index_type *const sa, size_t const n) {
+  gsaca_ds_iterator<p1_sorter, p2_sorter>(text + 1, sa, n - 2, 2);
+}
+
+// gsaca_ds2 on the raw text (without sentinels), which is not modified
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, typename value_type>
+static void gsaca_ds2_raw(value_type const *const text,
+                          index_type *const sa, size_t const n) {
+  gsaca_ds_raw<p1_sorter, p2_sorter>(text + 1, sa, n - 2, 2);
+}
+
+// automatic choice of the algorithm (see build_sa)
+template<typename index_type, typename value_type>
+static void gsaca_auto(value_type const *const text, index_type *const sa,
+                       size_t const n) {
+  build_options options;
+  options.report = true;
+  build_sa(text, sa, n, options);
+}
+
+template<typename index_type, typename value_type>
+static void gsaca_auto_par(value_type const *const text, index_type *const sa,
+                           size_t const n, size_t const threads) {
+  build_options options;
+  options.threads = threads;
+  options.report = true;
+  build_sa(text, sa, n, options);
+}
+
 
 int main(int argc, char const *argv[]) {
   tlx::CmdlineParser cp;
@@ -103,7 +201,14 @@ int main(int argc, char const *argv[]) {
   cp.add_bytes('r', "runs", s.number_of_runs,
                "Number of repetitions of the algorithm (default = 5).");
   cp.add_bytes('l', "length", s.prefix_size,
-               "Length of the prefix of the text that should be considered.");
+               "Length of the prefix of the file that should be considered "
+               "(in bytes; in characters for varints).");
+  cp.add_bytes('\0', "bytes-per-char", s.bytes_per_char,
+               "Width of the characters in the file: 1, 2, 4 or 8 bytes, or 0 "
+               "for varints (default = 1).");
+  cp.add_bytes('\0', "synthetic", s.synthetic_size,
+               "Additionally run on a synthetic DNA-like text of the given "
+               "length (e.g., 3Gi to check 32-bit SAs on texts > 2 GiB).");
 
   cp.add_string('\0', "contains", s.contains_all, "Alias for --contains-all");
   cp.add_string('\0', "contains-any", s.contains_any,
@@ -126,6 +231,15 @@ int main(int argc, char const *argv[]) {
                 "OMP threads (multiple options possible; comma separated, e.g. "
                 "\"1,2,4,8\").");
 
+  cp.add_string('\0', "prefixes", s.list_of_prefixes,
+                "Execute gsaca_dsK using the given prefix lengths "
+                "(comma separated, e.g. \"4,8,12,16\").");
+
+  cp.add_string('\0', "sort-config", s.sort_config,
+                "Load the thresholds of the adaptive sorter from the given "
+                "file. If the file does not exist, the thresholds are "
+                "calibrated and written to the file.");
+
   cp.add_flag('\0', "list", s.list, "List the available algorithms.");
   cp.add_flag('\0', "check", s.check,
               "Check the correctness against divsufsort.");
@@ -137,21 +251,57 @@ int main(int argc, char const *argv[]) {
   if (s.list) {
     std::cout << "gsaca (by Uwe Baier)" << std::endl;
     std::cout << "gsaca_hash_ds" << std::endl;
+    std::cout << "gsaca_hash12_ds" << std::endl;
+    std::cout << "gsaca_hash16_ds" << std::endl;
     std::cout << "gsaca_ds1" << std::endl;
     std::cout << "gsaca_ds2" << std::endl;
     std::cout << "gsaca_ds3" << std::endl;
+    std::cout << "gsaca_dsK" << std::endl;
+    std::cout << "gsaca_auto" << std::endl;
+    std::cout << "gsaca_hash_ds-adaptive" << std::endl;
+    std::cout << "gsaca_ds1-adaptive" << std::endl;
+    std::cout << "gsaca_ds2-adaptive" << std::endl;
+    std::cout << "gsaca_ds3-adaptive" << std::endl;
+    std::cout << "gsaca_ds2-msd-soa" << std::endl;
+    std::cout << "gsaca_ds2-msd-packed" << std::endl;
+    std::cout << "gsaca_ds2-lsd-soa" << std::endl;
+    std::cout << "gsaca_ds2-lsd-packed" << std::endl;
+    std::cout << "gsaca_ds2_bitvector" << std::endl;
+    std::cout << "gsaca_ds2_stream" << std::endl;
+    std::cout << "gsaca_ds2_raw" << std::endl;
+    std::cout << "gsaca_ds_reduced" << std::endl;
     std::cout << "gsaca_ds1_par" << std::endl;
     std::cout << "gsaca_ds2_par" << std::endl;
     std::cout << "gsaca_ds3_par" << std::endl;
+    std::cout << "gsaca_auto_par" << std::endl;
+    std::cout << "gsaca_ds2_par_bitvector" << std::endl;
     std::cout << "divsufsort (by Yuta Mori)" << std::endl;
     std::cout << "divsufsort_par (by Julian Labeit)" << std::endl;
     return 0;
   }
 
-  for (auto file : s.file_paths) {
+  if (s.sort_config.size() > 0) {
+    adaptive_internal::config() =
+        adaptive_internal::load_or_calibrate(s.sort_config);
+    std::cout << "Adaptive sorter: " << adaptive_internal::config().to_string()
+              << std::endl;
+  }
+
+  std::string const synthetic_name =
+      "synthetic-" + std::to_string(s.synthetic_size);
+  std::vector<std::string> inputs = s.file_paths;
+  if (s.synthetic_size > 0) {
+    inputs.push_back(synthetic_name);
+  }
+
+  for (auto file : inputs) {
     uint8_t sigma = 0;
     std::vector<uint8_t> text_vec =
-        file_to_instance(file, s.prefix_size, sigma);
+        (s.synthetic_size > 0 && file == synthetic_name)
+        ? synthetic_instance(s.synthetic_size, sigma)
+        : (s.bytes_per_char == 1)
+        ? file_to_instance(file, s.prefix_size, sigma)
+        : file_to_instance(file, s.prefix_size, sigma, s.bytes_per_char);
     const std::string info =
         std::string("file=") + file + " sigma=" + std::to_string(sigma);
 
@@ -177,7 +327,8 @@ int main(int argc, char const *argv[]) {
 
 #define run_with_sorting_type(name, sa_type, p1_sort, p2_sort, text, n) \
     { \
-        std::string name_with_sa_type = std::string(#name) + "-sa" + \
+        std::string name_with_sa_type = std::string(#name) + \
+            sorter_suffix<p1_sort, p2_sort>() + "-sa" + \
             std::to_string(sizeof(sa_type) * 8); \
         if (s.matches(name_with_sa_type)) { \
           if (s.check) { \
@@ -209,6 +360,24 @@ int main(int argc, char const *argv[]) {
         } \
   }
 
+#define run_with_prefix(name, sa_type, text, n) \
+    for (uint64_t k = 1; k < 256; ++k) { \
+        std::string name_with_sa_type = std::string(#name) + "-k" + \
+            std::to_string(k) + "-sa" + std::to_string(sizeof(sa_type) * 8); \
+        if (s.matches(name_with_sa_type) && s.matches_prefix(k)) { \
+            if (s.check) { \
+                std::vector<sa_type> sa_vec(n); \
+                name(text, sa_vec.data(), n, k); \
+                checker.check(sa_vec.data(), name_with_sa_type); \
+            } \
+            auto runner = [&](sa_type * const sa) { \
+               name(text, sa, n, k); \
+            }; \
+            run_generic<sa_type>(name_with_sa_type, info + " prefix=" + std::to_string(k), n, \
+                   s.number_of_runs, runner); \
+        } \
+    }
+
 #define run_parallel(name, sa_type, text, n) \
     for (int p = 1; p < 1025; ++p) { \
         std::string name_with_sa_type = std::string(#name) + "-sa" + \
@@ -229,36 +398,89 @@ int main(int argc, char const *argv[]) {
 
     run_with_sorting_type(gsaca_hash_ds, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_hash_ds, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash_ds, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_hash_ds, uint64_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash12_ds, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash12_ds, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash16_ds, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_hash16_ds, uint40_t, MSD, MSD, text, n)
 
     run_with_sorting_type(gsaca_ds1, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds1, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds1, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds1, uint64_t, MSD, MSD, text, n)
 
     run_with_sorting_type(gsaca_ds2, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds2, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds2, uint64_t, MSD, MSD, text, n)
 
     run_with_sorting_type(gsaca_ds3, uint32_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds3, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds3, uint48_t, MSD, MSD, text, n)
     run_with_sorting_type(gsaca_ds3, uint64_t, MSD, MSD, text, n)
 
+    run_with_sorting_type(gsaca_hash_ds, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_hash_ds, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds1, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds1, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds3, uint32_t, ADAPTIVE, ADAPTIVE, text, n)
+    run_with_sorting_type(gsaca_ds3, uint40_t, ADAPTIVE, ADAPTIVE, text, n)
+
+    run_with_sorting_type(gsaca_ds2, uint32_t, MSD_SOA, MSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, MSD_SOA, MSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, MSD_PACKED, MSD_PACKED, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, MSD_PACKED, MSD_PACKED, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, LSD_SOA, LSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, LSD_SOA, LSD_SOA, text, n)
+    run_with_sorting_type(gsaca_ds2, uint32_t, LSD_PACKED, LSD_PACKED, text, n)
+    run_with_sorting_type(gsaca_ds2, uint40_t, LSD_PACKED, LSD_PACKED, text, n)
+
+    run_with_sorting_type(gsaca_ds2_bitvector, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_bitvector, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_stream, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_stream, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_raw, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds2_raw, uint40_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds_reduced, uint32_t, MSD, MSD, text, n)
+    run_with_sorting_type(gsaca_ds_reduced, uint40_t, MSD, MSD, text, n)
+
+    run_with_prefix(gsaca_dsK, uint32_t, text, n)
+    run_with_prefix(gsaca_dsK, uint40_t, text, n)
+    run_with_prefix(gsaca_dsK, uint48_t, text, n)
+    run_with_prefix(gsaca_dsK, uint64_t, text, n)
+
     run_without_sorting_type(gsaca, int, text + 1, n - 1);
     run_without_sorting_type(divsufsort, int, text + 1, n - 1);
     run_without_sorting_type(divsufsort64, int64_t, text + 1, n - 1);
 
     run_parallel(gsaca_ds1_par, uint32_t, text, n)
     run_parallel(gsaca_ds1_par, uint40_t, text, n)
+    run_parallel(gsaca_ds1_par, uint48_t, text, n)
     run_parallel(gsaca_ds1_par, uint64_t, text, n)
 
     run_parallel(gsaca_ds2_par, uint32_t, text, n)
     run_parallel(gsaca_ds2_par, uint40_t, text, n)
+    run_parallel(gsaca_ds2_par, uint48_t, text, n)
     run_parallel(gsaca_ds2_par, uint64_t, text, n)
 
     run_parallel(gsaca_ds3_par, uint32_t, text, n)
     run_parallel(gsaca_ds3_par, uint40_t, text, n)
+    run_parallel(gsaca_ds3_par, uint48_t, text, n)
     run_parallel(gsaca_ds3_par, uint64_t, text, n)
 
+    run_without_sorting_type(gsaca_auto, uint32_t, text, n)
+    run_without_sorting_type(gsaca_auto, uint40_t, text, n)
+    run_without_sorting_type(gsaca_auto, uint64_t, text, n)
+    run_parallel(gsaca_auto_par, uint32_t, text, n)
+    run_parallel(gsaca_auto_par, uint40_t, text, n)
+    run_parallel(gsaca_auto_par, uint64_t, text, n)
+
+    run_parallel(gsaca_ds2_par_bitvector, uint32_t, text, n)
+    run_parallel(gsaca_ds2_par_bitvector, uint40_t, text, n)
+
     run_parallel(divsufsort_par32, int32_t, text + 1, n - 1)
     run_parallel(divsufsort_par64, int64_t, text + 1, n - 1)
   }
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <omp.h>
+#include <type_traits>
+#include <vector>
+#include <ips4o/ips4o.hpp>
+#include "common/macros.hpp"
+#include "common/memory.hpp"
+
+namespace gsaca_lyndon {
+
+// The alphabet of text[1, n - 1) (i.e., without the sentinel positions).
+struct alphabet_type {
+  // number of distinct characters
+  uint64_t sigma = 0;
+  // largest character
+  uint64_t max = 0;
+  // smallest character that does not occur (max + 1 if all characters up to
+  // max occur)
+  uint64_t mex = 0;
+
+  bool contains_zero() const {
+    return mex > 0;
+  }
+};
+
+namespace alphabet_internal {
+
+// the occurrences of wide characters are marked in a bit vector over
+// [0, max], unless the bit vector is larger than the text
+constexpr uint64_t max_bits_per_char = 32;
+
+// the first character (smaller than limit) whose bit is not set
+inline uint64_t first_unset(uint64_t const *const bits, uint64_t const limit) {
+  uint64_t const words = (limit + 63) >> 6;
+  for (uint64_t w = 0; w < words; ++w) {
+    if (~bits[w] != 0) {
+      return std::min(limit, (w << 6) + __builtin_ctzll(~bits[w]));
+    }
+  }
+  return limit;
+}
+
+// marks the characters of text[1, n - 1) in a bit vector over [0, max]
+template<typename value_type>
+uint64_t *mark_characters(value_type const *const text, size_t const n,
+                          uint64_t const max, size_t const threads) {
+  uint64_t const words = (max >> 6) + 1;
+  uint64_t *const bits = (uint64_t *) checked_calloc(words, sizeof(uint64_t));
+  #pragma omp parallel for num_threads(threads)
+  for (size_t i = 1; i < n - 1; ++i) {
+    uint64_t const c = text[i];
+    uint64_t const mask = 1ULL << (c & 63);
+    // most characters are already marked, avoid the atomic write
+    if ((bits[c >> 6] & mask) == 0) {
+      __atomic_fetch_or(&(bits[c >> 6]), mask, __ATOMIC_RELAXED);
+    }
+  }
+  return bits;
+}
+
+template<typename value_type>
+uint64_t max_character(value_type const *const text, size_t const n,
+                       size_t const threads) {
+  uint64_t max = 0;
+  #pragma omp parallel for reduction(max:max) num_threads(threads)
+  for (size_t i = 1; i < n - 1; ++i) {
+    max = std::max(max, (uint64_t) text[i]);
+  }
+  return max;
+}
+
+// writes rank(text[i]) to out[i] for all i in [1, n - 1) and adds sentinels
+template<typename out_type, typename value_type, typename rank_function>
+void map_characters(value_type const *const text, out_type *const out,
+                    size_t const n, rank_function const &rank,
+                    size_t const threads) {
+  #pragma omp parallel for num_threads(threads)
+  for (size_t i = 1; i < n - 1; ++i) {
+    out[i] = (out_type) rank(text[i]);
+  }
+  out[0] = 0;
+  out[n - 1] = 0;
+}
+
+} // namespace alphabet_internal
+
+// Byte alphabets: each thread marks its characters in a table of 256 flags,
+// the tables are combined afterwards.
+template<typename value_type>
+static std::enable_if_t<sizeof(value_type) == 1, alphabet_type>
+detect_alphabet(value_type const *const text, size_t const n,
+                size_t const threads = omp_get_max_threads()) {
+  alphabet_type result;
+  if (n < 3) return result;
+
+  std::vector<uint8_t> occurs(256 * threads, 0);
+  #pragma omp parallel num_threads(threads)
+  {
+    uint8_t *const local = &(occurs[256 * omp_get_thread_num()]);
+    #pragma omp for schedule(static)
+    for (size_t i = 1; i < n - 1; ++i) {
+      local[text[i]] = 1;
+    }
+  }
+
+  uint64_t bits[4] = {};
+  for (size_t t = 0; t < threads; ++t) {
+    for (uint64_t c = 0; c < 256; ++c) {
+      bits[c >> 6] |= ((uint64_t) occurs[256 * t + c]) << (c & 63);
+    }
+  }
+  for (uint64_t w = 0; w < 4; ++w) {
+    result.sigma += __builtin_popcountll(bits[w]);
+    if (bits[w] != 0) {
+      result.max = (w << 6) + 63 - __builtin_clzll(bits[w]);
+    }
+  }
+  result.mex = alphabet_internal::first_unset(bits, 256);
+  return result;
+}
+
+// Wide alphabets: the occurrences are marked in a shared bit vector over
+// [0, max] (atomic or). If the bit vector would be larger than the text, a
+// sorted copy of the text is used instead.
+template<typename value_type>
+static std::enable_if_t<(sizeof(value_type) > 1), alphabet_type>
+detect_alphabet(value_type const *const text, size_t const n,
+                size_t const threads = omp_get_max_threads()) {
+  alphabet_type result;
+  if (n < 3) return result;
+
+  using namespace alphabet_internal;
+  uint64_t const max = max_character(text, n, threads);
+  result.max = max;
+
+  if (max / max_bits_per_char <= n) {
+    uint64_t const words = (max >> 6) + 1;
+    uint64_t *const bits = mark_characters(text, n, max, threads);
+    uint64_t sigma = 0;
+    #pragma omp parallel for reduction(+:sigma) num_threads(threads)
+    for (uint64_t w = 0; w < words; ++w) {
+      sigma += __builtin_popcountll(bits[w]);
+    }
+    result.sigma = sigma;
+    result.mex = first_unset(bits, max + 1);
+    free(bits);
+  } else {
+    std::vector<value_type> sorted(&(text[1]), &(text[n - 1]));
+    ips4o::parallel::sort(sorted.begin(), sorted.end(), std::less<>(),
+                          threads);
+    result.sigma = 1;
+    result.mex = (sorted[0] == 0) ? 1 : 0;
+    for (size_t i = 1; i < sorted.size(); ++i) {
+      if (sorted[i - 1] != sorted[i]) {
+        ++result.sigma;
+        if (result.mex == (uint64_t) sorted[i]) ++result.mex;
+      }
+    }
+  }
+  return result;
+}
+
+// Maps the characters of text[1, n - 1) to their ranks 1, ..., sigma among
+// the distinct characters, such that the sentinels remain the smallest
+// characters, and calls f(compact_text). The compact text uses the narrowest
+// type that fits sigma + 1 characters (e.g., uint8_t for a 32-bit text with
+// sigma < 256), such that the initial bucketing and the memory footprint
+// depend on sigma rather than on the width of the input. If no narrower type
+// fits, f is called for the text itself.
+template<typename value_type, typename function_type>
+static auto with_compact_alphabet(value_type const *const text, size_t const n,
+                                  function_type &&f,
+                                  size_t const threads = omp_get_max_threads()) {
+  using namespace alphabet_internal;
+  if constexpr (sizeof(value_type) == 1) {
+    return f(text);
+  } else {
+    if (n < 3) return f(text);
+
+    uint64_t const max = max_character(text, n, threads);
+    uint64_t sigma;
+    uint64_t *bits = nullptr;
+    std::vector<uint64_t> ranks;
+    std::vector<value_type> sorted;
+    if (max / max_bits_per_char <= n) {
+      // rank(c) = number of marked characters before c (plus one)
+      bits = mark_characters(text, n, max, threads);
+      uint64_t const words = (max >> 6) + 1;
+      ranks.resize(words);
+      sigma = 0;
+      for (uint64_t w = 0; w < words; ++w) {
+        ranks[w] = sigma + 1;
+        sigma += __builtin_popcountll(bits[w]);
+      }
+    } else {
+      // rank(c) = position of c in the sorted distinct characters (plus one)
+      sorted.assign(&(text[1]), &(text[n - 1]));
+      ips4o::parallel::sort(sorted.begin(), sorted.end(), std::less<>(),
+                            threads);
+      sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+      sigma = sorted.size();
+    }
+
+    auto const compact = [&](auto type_tag) {
+        using out_type = decltype(type_tag);
+        std::vector<out_type> out(n);
+        if (bits != nullptr) {
+          map_characters(text, out.data(), n, [&](uint64_t const c) {
+              uint64_t const below = bits[c >> 6] & ((1ULL << (c & 63)) - 1);
+              return ranks[c >> 6] + __builtin_popcountll(below);
+          }, threads);
+          free(bits);
+        } else {
+          map_characters(text, out.data(), n, [&](value_type const c) {
+              return 1 + (std::lower_bound(sorted.begin(), sorted.end(), c) -
+                          sorted.begin());
+          }, threads);
+          std::vector<value_type>().swap(sorted);
+        }
+        return f((out_type const *) out.data());
+    };
+
+    if (sigma < (1ULL << 8)) {
+      return compact(uint8_t());
+    } else if (sizeof(value_type) > 2 && sigma < (1ULL << 16)) {
+      return compact(uint16_t());
+    } else if (sizeof(value_type) > 4 && sigma < (1ULL << 32)) {
+      return compact(uint32_t());
+    }
+    free(bits);
+    return f(text);
+  }
+}
+
+// Frees the character 0 for the sentinels: if 0 occurs in text[1, n - 1),
+// all characters smaller than the smallest unused character are incremented
+// (which preserves the order of the suffixes). Then the sentinels are
+// written. Returns false if no character is unused (then all 0s are replaced
+// by 1s, which changes the text).
+template<typename value_type>
+static bool add_sentinels(value_type *const text, size_t const n,
+                          alphabet_type const &alphabet,
+                          size_t const threads = omp_get_max_threads()) {
+  bool lossless = true;
+  if (alphabet.contains_zero()) {
+    uint64_t increase = alphabet.mex;
+    if (increase > (uint64_t) std::numeric_limits<value_type>::max()) {
+      increase = 1;
+      lossless = false;
+    }
+    value_type const limit = (value_type) increase;
+    // branch free, such that the loop is vectorized
+    #pragma omp parallel for num_threads(threads)
+    for (size_t i = 1; i < n - 1; ++i) {
+      text[i] += (text[i] < limit);
+    }
+  }
+  text[0] = 0;
+  text[n - 1] = 0;
+  return lossless;
+}
+
+} // namespace gsaca_lyndon
@@ -27,8 +27,7 @@ safe_extract(value_type const *const text, count_type const &idx,
     result <<= (sizeof(value_type)*8);
     result |= text[idx + i];
   }
-  uint8_t const shift = sizeof(value_type) == 1 ? 3 : 5;
-  return result << ((count - i) << shift);
+  return result << ((count - i) * (sizeof(value_type) * 8));
 }
 
 }
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+#include "macros.hpp"
+
+namespace gsaca_lyndon {
+
+// malloc and calloc that throw std::bad_alloc instead of returning nullptr
+// (the C library reports this as -2, see gsaca-lyndon.h)
+static inline void *checked_malloc(size_t const bytes) {
+  void *const memory = malloc(bytes);
+  if (gsaca_unlikely(memory == nullptr && bytes > 0)) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+static inline void *checked_calloc(size_t const count, size_t const size) {
+  void *const memory = calloc(count, size);
+  if (gsaca_unlikely(memory == nullptr && count > 0 && size > 0)) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+// Frees a malloc'd buffer when the scope is left, also by an exception (e.g.,
+// if a later allocation fails). reset() frees it early.
+class scoped_free {
+  void *memory;
+
+public:
+  explicit scoped_free(void *const memory) : memory(memory) {}
+
+  scoped_free(scoped_free const &) = delete;
+  scoped_free &operator=(scoped_free const &) = delete;
+
+  ~scoped_free() {
+    free(memory);
+  }
+
+  void reset() {
+    free(memory);
+    memory = nullptr;
+  }
+};
+
+} // namespace gsaca_lyndon
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "common/phase_types.hpp"
+
+namespace gsaca_lyndon {
+
+// Highly repetitive texts (e.g., long runs of a single character) produce huge
+// groups that consist of a single chain of positions i, i + step, i + 2step,
+// ... Both phases resolve such groups directly, without scratch memory.
+
+namespace runs_internal {
+
+// groups of at least this size are checked in parallel
+constexpr size_t parallel_check_min = 1ULL << 16;
+// only groups of at least this size are excluded from the scratch memory
+constexpr size_t chain_check_min = 1ULL << 12;
+
+} // namespace runs_internal
+
+// Whether interval[i + 1] = interval[i] + step for all i (ignoring flags).
+template<typename F, typename index_type>
+static inline bool is_single_chain(index_type const *const interval,
+                                   size_t const size, size_t const step,
+                                   size_t const threads = 1) {
+  // most groups are no chains, which is usually detected right away
+  size_t const seq_end =
+      (threads > 1) ? std::min(size, runs_internal::parallel_check_min) : size;
+  for (size_t i = 1; i < seq_end; ++i) {
+    if ((uint64_t) F::remove_flag(interval[i]) !=
+        (uint64_t) F::remove_flag(interval[i - 1]) + step) {
+      return false;
+    }
+  }
+  bool result = true;
+  #pragma omp parallel for reduction(&&:result) num_threads(threads) if(threads > 1)
+  for (size_t i = std::max((size_t) 1, seq_end); i < size; ++i) {
+    result = result && ((uint64_t) F::remove_flag(interval[i]) ==
+                        (uint64_t) F::remove_flag(interval[i - 1]) + step);
+  }
+  return result;
+}
+
+// Phase 1: resolves a group (that has to be checked for runs) whose positions
+// form a single chain. If the suffix behind the last position is already
+// ranked, each position forms a singleton group. These are ranked right away,
+// from the last to the first position (i.e., in the order in which they would
+// be taken from the stack). Otherwise, the whole group is final.
+template<typename F, typename count_type,
+    typename index_type, typename buffer_type>
+static inline void
+phase_1_resolve_chain(index_type const *const sa_interval,
+                      buffer_type *const rank, count_type const gstart,
+                      count_type const gsize, count_type const gcontext,
+                      std::vector<phase_2_group_type<buffer_type>> &result,
+                      phase_1_stack_type<buffer_type> &input_groups) {
+  using output_type = phase_2_group_type<buffer_type>;
+  using input_type = phase_1_group_type<buffer_type>;
+
+  if (rank[F::remove_flag(sa_interval[gsize - 1]) + gcontext] == 0) {
+    input_groups.emplace_back(
+        input_type{gstart, gsize, gcontext, false, true});
+    return;
+  }
+  for (count_type i = gsize; i > 0; --i) {
+    index_type const idx = F::remove_flag(sa_interval[i - 1]);
+    rank[idx] = result.size();
+    count_type context = gcontext;
+    while (rank[idx + context] != 0) {
+      context += result[rank[idx + context]].lyndon;
+    }
+    result.emplace_back(output_type{context, 1});
+  }
+}
+
+// Phase 2: induces the order of a group whose positions form a single chain.
+// Each position forms its own subgroup, and the subgroups are ordered from the
+// last to the first position.
+template<typename F, typename count_type,
+    typename index_type, typename buffer_type>
+static inline void
+phase_2_resolve_chain(index_type *const sa_interval, buffer_type *const isa,
+                      count_type const left_border, count_type const gsize,
+                      F const &flags, size_t const threads = 1) {
+  bool const parallel =
+      threads > 1 && gsize >= runs_internal::parallel_check_min;
+  #pragma omp parallel for num_threads(threads) if(parallel)
+  for (count_type i = 0; i < (gsize >> 1); ++i) {
+    std::swap(sa_interval[i], sa_interval[gsize - 1 - i]);
+  }
+  #pragma omp parallel for num_threads(threads) if(parallel)
+  for (count_type i = 0; i < gsize; ++i) {
+    if (!flags.is_flagged(sa_interval[i])) {
+      isa[sa_interval[i]] = left_border + i;
+    } else {
+      sa_interval[i] = F::remove_flag(sa_interval[i]);
+    }
+  }
+}
+
+namespace runs_internal {
+
+// a group that is large enough to be checked for a chain before the phase
+struct chain_candidate {
+  size_t group;
+  size_t start;
+  size_t size;
+  size_t step;
+  bool is_chain;
+};
+
+// Checks the candidates (given per thread) for chains. Returns the size of the
+// largest candidate that is no chain, and appends the chains to chain_groups
+// (in the order of the candidates).
+template<typename F, typename index_type>
+static size_t
+check_candidates(index_type const *const sa,
+                 std::vector<std::vector<chain_candidate>> &per_thread,
+                 std::vector<size_t> &chain_groups, size_t const threads) {
+  std::vector<chain_candidate> candidates;
+  for (auto &local : per_thread) {
+    candidates.insert(candidates.end(), local.begin(), local.end());
+  }
+  // smaller candidates are checked by one thread each, larger ones by all
+  #pragma omp parallel for schedule(dynamic, 1) num_threads(threads) if(threads > 1)
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    chain_candidate &c = candidates[k];
+    if (threads == 1 || c.size < parallel_check_min) {
+      c.is_chain = is_single_chain<F>(&(sa[c.start]), c.size, c.step);
+    }
+  }
+  size_t result = 0;
+  for (chain_candidate &c : candidates) {
+    if (threads > 1 && c.size >= parallel_check_min) {
+      c.is_chain = is_single_chain<F>(&(sa[c.start]), c.size, c.step, threads);
+    }
+    if (c.is_chain) {
+      chain_groups.push_back(c.group);
+    } else {
+      result = std::max(result, c.size);
+    }
+  }
+  return result;
+}
+
+// first group of part t (of threads parts)
+inline size_t part_begin(size_t const size, size_t const t,
+                         size_t const threads) {
+  return std::min(size, t * (size / threads + (size % threads > 0)));
+}
+
+} // namespace runs_internal
+
+// Whether group g is the next one of the chain groups (which are queried in
+// the order in which they were found).
+inline bool is_next_chain(std::vector<size_t> const &chain_groups,
+                          size_t &next, size_t const g) {
+  if (next < chain_groups.size() && chain_groups[next] == g) {
+    ++next;
+    return true;
+  }
+  return false;
+}
+
+// Phase 1: size of the largest input group that is not resolved by
+// phase_1_resolve_chain (this determines the scratch memory, the subgroups
+// are never larger than their group). The input groups of at least
+// chain_check_min positions that form a chain are stored in chain_groups,
+// by decreasing index (i.e., in the order in which they are taken from the
+// stack).
+template<typename F, typename index_type, typename buffer_type>
+static size_t
+max_non_chain_group_size(index_type const *const sa,
+                         phase_1_stack_type<buffer_type> const &input_groups,
+                         std::vector<size_t> &chain_groups,
+                         size_t const threads = 1) {
+  using namespace runs_internal;
+  size_t const number_of_groups = input_groups.size();
+  std::vector<std::vector<chain_candidate>> per_thread(threads);
+  size_t result = 0;
+  #pragma omp parallel for reduction(max:result) num_threads(threads) if(threads > 1)
+  for (size_t t = 0; t < threads; ++t) {
+    // (backwards, like the stack)
+    for (size_t k = part_begin(number_of_groups, t, threads);
+         k < part_begin(number_of_groups, t + 1, threads); ++k) {
+      size_t const g = number_of_groups - 1 - k;
+      auto const &group = input_groups[g];
+      if (group.check_for_runs && group.size >= chain_check_min) {
+        per_thread[t].push_back(chain_candidate{g, (size_t) group.start,
+                                                (size_t) group.size,
+                                                (size_t) group.context,
+                                                false});
+      } else {
+        result = std::max(result, (size_t) group.size);
+      }
+    }
+  }
+  return std::max(result, check_candidates<F>(sa, per_thread, chain_groups,
+                                              threads));
+}
+
+// Phase 2: size of the largest group that is not resolved by
+// phase_2_resolve_chain (this determines the scratch memory). The groups of
+// at least chain_check_min positions that form a chain are stored in
+// chain_groups (by increasing index).
+template<typename F, typename index_type, typename buffer_type>
+static size_t
+max_non_chain_group_size(index_type const *const sa,
+                         phase_2_group_type<buffer_type> const *const groups,
+                         size_t const number_of_groups,
+                         std::vector<size_t> &chain_groups,
+                         size_t const threads = 1) {
+  using namespace runs_internal;
+  size_t const m = (number_of_groups > 2) ? number_of_groups - 2 : 0;
+  // left border of each part
+  std::vector<size_t> part_border(threads + 1, 0);
+  std::vector<std::vector<chain_candidate>> per_thread(threads);
+  size_t result = 0;
+  #pragma omp parallel num_threads(threads) if(threads > 1)
+  {
+    #pragma omp for reduction(max:result)
+    for (size_t t = 0; t < threads; ++t) {
+      size_t sum = 0;
+      for (size_t g = 2 + part_begin(m, t, threads);
+           g < 2 + part_begin(m, t + 1, threads); ++g) {
+        sum += groups[g].size;
+        if (groups[g].size < chain_check_min) {
+          result = std::max(result, (size_t) groups[g].size);
+        }
+      }
+      part_border[t + 1] = sum;
+    }
+    #pragma omp single
+    {
+      part_border[0] = 2;
+      for (size_t t = 0; t < threads; ++t) {
+        part_border[t + 1] += part_border[t];
+      }
+    }
+    #pragma omp for
+    for (size_t t = 0; t < threads; ++t) {
+      size_t left_border = part_border[t];
+      for (size_t g = 2 + part_begin(m, t, threads);
+           g < 2 + part_begin(m, t + 1, threads); ++g) {
+        size_t const gsize = groups[g].size;
+        if (gsize >= chain_check_min) {
+          per_thread[t].push_back(chain_candidate{g, left_border, gsize,
+                                                  (size_t) groups[g].lyndon,
+                                                  false});
+        }
+        left_border += gsize;
+      }
+    }
+  }
+  return std::max(result, check_candidates<F>(sa, per_thread, chain_groups,
+                                              threads));
+}
+
+} // namespace gsaca_lyndon
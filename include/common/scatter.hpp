@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "common/macros.hpp"
+#include "common/memory.hpp"
+
+namespace gsaca_lyndon {
+
+// Stable scatter of the positions [begin, end) into many buckets, i.e.,
+// sa[borders[key_of(i)]++] = value_of(i). Writing each position directly to
+// the cursor of its bucket touches a different cache line (and often a
+// different page) for almost every position once the cursors do not fit into
+// the cache anymore. Instead, the values (together with the remaining key bits)
+// are first distributed by the 8 most significant key bits into scratch
+// memory, using one cache line sized buffer per coarse bucket (software write
+// combining, as in ips4o). Afterwards, each coarse bucket is scattered by the
+// full key, which only uses its own range of cursors and of the SA. Keys may
+// have at most 24 bits.
+//
+// borders[b] has to be the left border of bucket b for ALL 2^key_bits buckets
+// (empty buckets included). As in the direct scatter, borders[b] is the right
+// border of bucket b afterwards.
+
+namespace scatter_internal {
+
+constexpr uint64_t coarse_bits = 8;
+constexpr uint64_t coarse_buckets = 1ULL << coarse_bits;
+constexpr uint64_t line_bytes = 64;
+
+// the direct scatter is faster as long as the cursors of all (non-empty)
+// buckets fit into the L2 cache
+constexpr uint64_t min_scatter_buckets = 1ULL << 16;
+
+template<typename index_type>
+struct scratch_entry {
+  index_type value;
+  uint16_t fine_key;
+} __attribute__((packed));
+
+template<typename index_type>
+struct alignas(line_bytes) line {
+  static constexpr uint64_t capacity =
+      line_bytes / sizeof(scratch_entry<index_type>);
+  scratch_entry<index_type> entries[capacity];
+};
+
+// level 1: distributes [begin, end) into scratch, cursors[c] is the next free
+// slot of coarse bucket c
+template<typename index_type, typename count_type, typename key_function,
+    typename value_function>
+gsaca_always_inline void
+combine_coarse(scratch_entry<index_type> *const scratch,
+               count_type *const cursors, uint8_t const shift,
+               count_type const begin, count_type const end,
+               key_function const &key_of, value_function const &value_of) {
+  using line_type = line<index_type>;
+  constexpr uint64_t capacity = line_type::capacity;
+  uint64_t const fine_mask = (1ULL << shift) - 1;
+  line_type lines[coarse_buckets];
+  uint8_t fill[coarse_buckets] = {};
+
+  for (count_type i = begin; i < end; ++i) {
+    uint64_t const key = key_of(i);
+    uint64_t const c = key >> shift;
+    lines[c].entries[fill[c]] =
+        scratch_entry<index_type>{value_of(i), (uint16_t) (key & fine_mask)};
+    if (gsaca_unlikely(++fill[c] == capacity)) {
+      memcpy(&(scratch[cursors[c]]), lines[c].entries,
+             sizeof(lines[c].entries));
+      cursors[c] += capacity;
+      fill[c] = 0;
+    }
+  }
+  for (uint64_t c = 0; c < coarse_buckets; ++c) {
+    memcpy(&(scratch[cursors[c]]), lines[c].entries,
+           fill[c] * sizeof(scratch_entry<index_type>));
+    cursors[c] += fill[c];
+  }
+}
+
+// level 2: scatters scratch[begin, end) (coarse bucket c) by the full keys
+template<typename index_type, typename count_type>
+gsaca_always_inline void
+scatter_fine(scratch_entry<index_type> const *const scratch,
+             index_type *const sa, count_type *const borders,
+             uint8_t const shift, uint64_t const c, uint64_t const begin,
+             uint64_t const end) {
+  count_type *const fine_borders = &(borders[c << shift]);
+  for (uint64_t k = begin; k < end; ++k) {
+    sa[fine_borders[scratch[k].fine_key]++] = scratch[k].value;
+  }
+}
+
+} // namespace scatter_internal
+
+template<typename count_type, typename index_type, typename key_function,
+    typename value_function>
+static void blocked_scatter(index_type *const sa, count_type *const borders,
+                            uint8_t const key_bits, count_type const begin,
+                            count_type const end, key_function const &key_of,
+                            value_function const &value_of) {
+  using namespace scatter_internal;
+  using entry_type = scratch_entry<index_type>;
+  uint8_t const shift = key_bits - std::min<uint64_t>(key_bits, coarse_bits);
+  count_type const base = borders[0];
+
+  // the coarse buckets are unions of consecutive buckets
+  count_type cursors[coarse_buckets];
+  for (uint64_t c = 0; c < coarse_buckets; ++c) {
+    cursors[c] = ((c << shift) >> key_bits) ? end - begin
+                                            : borders[c << shift] - base;
+  }
+
+  entry_type *const scratch =
+      (entry_type *) checked_malloc((end - begin) * sizeof(entry_type));
+  combine_coarse(scratch, cursors, shift, begin, end, key_of, value_of);
+  // cursors[c] is now the right border of coarse bucket c
+  uint64_t left = 0;
+  for (uint64_t c = 0; c < coarse_buckets; ++c) {
+    scatter_fine(scratch, sa, borders, shift, c, left, cursors[c]);
+    left = cursors[c];
+  }
+  free(scratch);
+}
+
+// Parallel version, which also counts the buckets: borders has to be zero
+// initialized, and the buckets are placed from first_border on. Each thread
+// distributes one chunk of [begin, end) into its own part of each coarse
+// bucket. Then, each coarse bucket is counted and scattered by a single thread
+// (the coarse buckets use disjoint ranges of the borders and of the SA). Only
+// coarse buckets with more than a thread's share of the positions are split
+// between all threads, which needs one histogram of 2^(key_bits - 8) counters
+// per thread. Thus, the whole histogram is only needed once (instead of once
+// per thread).
+template<typename count_type, typename index_type, typename key_function,
+    typename value_function>
+static void
+blocked_bucket_parallel(index_type *const sa, count_type *const borders,
+                        uint8_t const key_bits, count_type const begin,
+                        count_type const end, count_type const first_border,
+                        key_function const &key_of,
+                        value_function const &value_of, size_t const threads) {
+  using namespace scatter_internal;
+  using entry_type = scratch_entry<index_type>;
+  uint8_t const shift = key_bits - std::min<uint64_t>(key_bits, coarse_bits);
+  uint64_t const used_coarse_buckets = 1ULL << (key_bits - shift);
+  uint64_t const fine_buckets = 1ULL << shift;
+  uint64_t const m = end - begin;
+  auto part_begin = [&](uint64_t const size, uint64_t const t) {
+      return std::min(size, t * (size / threads + (size % threads > 0)));
+  };
+
+  // counting (per thread and coarse bucket)
+  std::vector<count_type> cursors_vec(coarse_buckets * threads);
+  count_type *const cursors = cursors_vec.data();
+  #pragma omp parallel for
+  for (size_t t = 0; t < threads; ++t) {
+    count_type *const histogram = &(cursors[coarse_buckets * t]);
+    for (count_type i = begin + part_begin(m, t);
+         i < begin + part_begin(m, t + 1); ++i) {
+      ++histogram[key_of(i) >> shift];
+    }
+  }
+  uint64_t coarse_borders[coarse_buckets + 1];
+  uint64_t sum = 0;
+  for (uint64_t c = 0; c < coarse_buckets; ++c) {
+    coarse_borders[c] = sum;
+    for (size_t t = 0; t < threads; ++t) {
+      count_type const count = cursors[coarse_buckets * t + c];
+      cursors[coarse_buckets * t + c] = sum;
+      sum += count;
+    }
+  }
+  coarse_borders[coarse_buckets] = sum;
+
+  entry_type *const scratch =
+      (entry_type *) checked_malloc(m * sizeof(entry_type));
+  #pragma omp parallel for
+  for (size_t t = 0; t < threads; ++t) {
+    combine_coarse(scratch, &(cursors[coarse_buckets * t]), shift,
+                   (count_type) (begin + part_begin(m, t)),
+                   (count_type) (begin + part_begin(m, t + 1)), key_of,
+                   value_of);
+  }
+
+  auto is_large = [&](uint64_t const c) {
+      return threads > 1 &&
+             coarse_borders[c + 1] - coarse_borders[c] > m / threads;
+  };
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (uint64_t c = 0; c < used_coarse_buckets; ++c) {
+    if (is_large(c)) continue;
+    count_type *const fine_borders = &(borders[c << shift]);
+    for (uint64_t k = coarse_borders[c]; k < coarse_borders[c + 1]; ++k) {
+      ++fine_borders[scratch[k].fine_key];
+    }
+    count_type border = first_border + coarse_borders[c];
+    for (uint64_t b = 0; b < fine_buckets; ++b) {
+      count_type const count = fine_borders[b];
+      fine_borders[b] = border;
+      border += count;
+    }
+    scatter_fine(scratch, sa, borders, shift, c, coarse_borders[c],
+                 coarse_borders[c + 1]);
+  }
+
+  std::vector<count_type> local_vec;
+  for (uint64_t c = 0; c < used_coarse_buckets; ++c) {
+    if (!is_large(c)) continue;
+    local_vec.assign(fine_buckets * threads, 0);
+    count_type *const local = local_vec.data();
+    uint64_t const size = coarse_borders[c + 1] - coarse_borders[c];
+    entry_type const *const entries = &(scratch[coarse_borders[c]]);
+
+    #pragma omp parallel for
+    for (size_t t = 0; t < threads; ++t) {
+      count_type *const histogram = &(local[fine_buckets * t]);
+      for (uint64_t k = part_begin(size, t); k < part_begin(size, t + 1); ++k) {
+        ++histogram[entries[k].fine_key];
+      }
+    }
+    count_type *const fine_borders = &(borders[c << shift]);
+    count_type border = first_border + coarse_borders[c];
+    for (uint64_t b = 0; b < fine_buckets; ++b) {
+      for (size_t t = 0; t < threads; ++t) {
+        count_type const count = local[fine_buckets * t + b];
+        local[fine_buckets * t + b] = border;
+        border += count;
+      }
+      fine_borders[b] = border;
+    }
+    #pragma omp parallel for
+    for (size_t t = 0; t < threads; ++t) {
+      count_type *const cursor = &(local[fine_buckets * t]);
+      for (uint64_t k = part_begin(size, t); k < part_begin(size, t + 1); ++k) {
+        sa[cursor[entries[k].fine_key]++] = entries[k].value;
+      }
+    }
+  }
+  free(scratch);
+}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "common/macros.hpp"
+
+namespace gsaca_lyndon {
+
+// Reading texts of integer symbols from (binary) streams. Symbols are either
+// fixed-width unsigned integers of 1, 2, 4 or 8 bytes in native (i.e., little
+// endian on x86) byte order, or varints (LEB128: 7 bits per byte, least
+// significant group first, the highest bit marks continuation). The texts
+// get two additional positions for the sentinels, which are set to 0.
+
+// bytes_per_char value that selects varint symbols
+constexpr uint64_t varint_bytes_per_char = 0;
+
+namespace text_reader_internal {
+
+// bytes per read
+constexpr size_t chunk_bytes = 1ULL << 20;
+
+inline bool valid_width(uint64_t const bytes_per_char) {
+  return bytes_per_char == 1 || bytes_per_char == 2 || bytes_per_char == 4 ||
+         bytes_per_char == 8 || bytes_per_char == varint_bytes_per_char;
+}
+
+template<typename value_type>
+gsaca_always_inline value_type checked(uint64_t const symbol) {
+  if (gsaca_unlikely(symbol > std::numeric_limits<value_type>::max())) {
+    throw std::out_of_range(
+        "gsaca_lyndon::read_text: symbol does not fit the character type");
+  }
+  return (value_type) symbol;
+}
+
+template<typename symbol_type>
+gsaca_always_inline uint64_t load(uint8_t const *const bytes) {
+  symbol_type symbol;
+  memcpy(&symbol, bytes, sizeof(symbol_type));
+  return symbol;
+}
+
+// Decodes varints chunk by chunk and calls f(symbol) for each of them, until
+// the stream ends or max_chars symbols are decoded (0 = no limit). A
+// truncated last varint is an error.
+template<typename function_type>
+void for_each_varint(std::istream &stream, uint64_t const max_chars,
+                     function_type &&f) {
+  std::vector<uint8_t> chunk(chunk_bytes);
+  uint64_t count = 0;
+  uint64_t symbol = 0;
+  uint8_t shift = 0;
+  while (max_chars == 0 || count < max_chars) {
+    stream.read((char *) chunk.data(), chunk_bytes);
+    size_t const length = stream.gcount();
+    if (length == 0) break;
+    for (size_t i = 0; i < length; ++i) {
+      uint8_t const byte = chunk[i];
+      // the tenth byte holds the most significant bit (and ends the varint)
+      if (gsaca_unlikely(shift == 63 && byte > 1)) {
+        throw std::out_of_range(
+            "gsaca_lyndon::read_text: varint exceeds 64 bits");
+      }
+      symbol |= ((uint64_t) (byte & 0x7F)) << shift;
+      shift += 7;
+      if ((byte & 0x80) == 0) {
+        f(symbol);
+        symbol = 0;
+        shift = 0;
+        if (++count == max_chars) break;
+      }
+    }
+  }
+  if (gsaca_unlikely(shift > 0 && (max_chars == 0 || count < max_chars))) {
+    throw std::length_error("gsaca_lyndon::read_text: truncated varint");
+  }
+}
+
+// the size of fixed-width texts is taken from the stream, a shorter read means
+// the stream changed or failed
+inline void read_exactly(std::istream &stream, void *const out,
+                         uint64_t const bytes) {
+  stream.read((char *) out, bytes);
+  if (gsaca_unlikely((uint64_t) stream.gcount() != bytes)) {
+    throw std::length_error("gsaca_lyndon::read_text: stream ended early");
+  }
+}
+
+inline std::streampos checked_tellg(std::istream &stream) {
+  auto const position = stream.tellg();
+  if (gsaca_unlikely(position == std::streampos(-1))) {
+    throw std::invalid_argument(
+        "gsaca_lyndon::read_text: the stream is not seekable");
+  }
+  return position;
+}
+
+} // namespace text_reader_internal
+
+// Reads at most max_chars symbols (0 = the whole stream) of the given width
+// into a text of value_type (plus sentinels). Symbols of the same width are
+// read directly into the text, other widths are decoded chunk by chunk. An
+// incomplete symbol at the end of the stream is ignored. Throws
+// std::out_of_range if a symbol does not fit value_type. Fixed-width symbols
+// need a seekable stream (std::invalid_argument otherwise), and
+// std::length_error is thrown if it yields less than its size.
+template<typename value_type>
+static std::vector<value_type> read_text(std::istream &stream,
+                                         uint64_t const bytes_per_char,
+                                         uint64_t const max_chars = 0) {
+  using namespace text_reader_internal;
+  static_assert(std::is_unsigned<value_type>::value);
+  if (!valid_width(bytes_per_char)) {
+    throw std::invalid_argument(
+        "gsaca_lyndon::read_text: symbols must have 1, 2, 4 or 8 bytes");
+  }
+
+  std::vector<value_type> result(1, 0);
+  if (bytes_per_char == varint_bytes_per_char) {
+    for_each_varint(stream, max_chars, [&](uint64_t const symbol) {
+        result.push_back(checked<value_type>(symbol));
+    });
+    result.push_back(0);
+    return result;
+  }
+
+  // the number of symbols is known from the size of the stream
+  auto const begin = checked_tellg(stream);
+  stream.seekg(0, std::ios::end);
+  uint64_t chars = (checked_tellg(stream) - begin) / bytes_per_char;
+  stream.seekg(begin);
+  if (max_chars > 0) chars = std::min(chars, max_chars);
+  result.resize(chars + 2, 0);
+
+  if (bytes_per_char == sizeof(value_type)) {
+    read_exactly(stream, &(result[1]), chars * sizeof(value_type));
+    return result;
+  }
+
+  std::vector<uint8_t> chunk(chunk_bytes);
+  uint64_t const chunk_chars = chunk_bytes / bytes_per_char;
+  for (uint64_t i = 0; i < chars; i += chunk_chars) {
+    uint64_t const length = std::min(chunk_chars, chars - i);
+    read_exactly(stream, chunk.data(), length * bytes_per_char);
+    value_type *const out = &(result[i + 1]);
+    uint8_t const *const in = chunk.data();
+    switch (bytes_per_char) {
+      case 1:
+        for (uint64_t j = 0; j < length; ++j) {
+          out[j] = (value_type) in[j];
+        }
+        break;
+      case 2:
+        for (uint64_t j = 0; j < length; ++j) {
+          out[j] = checked<value_type>(load<uint16_t>(in + 2 * j));
+        }
+        break;
+      case 4:
+        for (uint64_t j = 0; j < length; ++j) {
+          out[j] = checked<value_type>(load<uint32_t>(in + 4 * j));
+        }
+        break;
+      default:
+        for (uint64_t j = 0; j < length; ++j) {
+          out[j] = checked<value_type>(load<uint64_t>(in + 8 * j));
+        }
+    }
+  }
+  return result;
+}
+
+// Reads the text into the narrowest type that fits its symbols and calls
+// f(text), where text is a std::vector of uint8_t, uint16_t, uint32_t or
+// uint64_t (including sentinel positions). Fixed-width symbols use the type of
+// their width. Varints are scanned twice (which requires a seekable stream):
+// first to find the largest symbol, then to decode them.
+template<typename function_type>
+static auto with_text(std::istream &stream, uint64_t const bytes_per_char,
+                      uint64_t const max_chars, function_type &&f) {
+  using namespace text_reader_internal;
+  uint64_t width = bytes_per_char;
+  if (bytes_per_char == varint_bytes_per_char) {
+    auto const begin = checked_tellg(stream);
+    uint64_t max = 0;
+    for_each_varint(stream, max_chars, [&](uint64_t const symbol) {
+        max = std::max(max, symbol);
+    });
+    stream.clear();
+    stream.seekg(begin);
+    // room for one more character (see add_sentinels)
+    width = (max < (1ULL << 8) - 1) ? 1 : (max < (1ULL << 16) - 1) ? 2 :
+            (max < (1ULL << 32) - 1) ? 4 : 8;
+  }
+  switch (width) {
+    case 1:
+      return f(read_text<uint8_t>(stream, bytes_per_char, max_chars));
+    case 2:
+      return f(read_text<uint16_t>(stream, bytes_per_char, max_chars));
+    case 4:
+      return f(read_text<uint32_t>(stream, bytes_per_char, max_chars));
+    default:
+      return f(read_text<uint64_t>(stream, bytes_per_char, max_chars));
+  }
+}
+
+} // namespace gsaca_lyndon
@@ -26,11 +26,14 @@ auto operator x(const T &b) const { \
   return *this x (UIntPair) b; \
 }
 
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
 #include <limits>
 #include <ostream>
 #include <cstdint>
 #include "macros.hpp"
+#include "memory.hpp"
 
 namespace gsaca_lyndon {
 
@@ -319,7 +322,13 @@ public:
 } // namespace internal
 
 
+// The flag types are instantiated once per SACA call (by the entry point) and
+// passed to the functions that read flags. Bitset and none are stateless, and
+// their constructors accept the arguments of flag_type_bitvector.
 struct flag_type_bitset {
+  template<typename... args_type>
+  explicit flag_type_bitset(args_type const &...) {}
+
   template<typename T>
   inline static T add_flag(T t) {
     static_assert(std::is_integral_v<T> && std::is_unsigned_v<T>);
@@ -359,7 +368,8 @@ struct flag_type_bitset {
   template<typename H>
   inline static uint_internal::UIntPair<H>
   remove_flag(uint_internal::UIntPair<H> t) {
-    (t.high_ <<= 1) >>= 1;
+    constexpr H mask = std::numeric_limits<H>::max() >> 1;
+    t.high_ &= mask;
     return t;
   }
 
@@ -378,6 +388,9 @@ struct flag_type_bitset {
 };
 
 struct flag_type_none {
+  template<typename... args_type>
+  explicit flag_type_none(args_type const &...) {}
+
   template<typename T>
   inline static T const &add_flag(T const &t) {
     return t;
@@ -399,9 +412,82 @@ struct flag_type_none {
   }
 };
 
-template<bool use_flags>
+// Keeps the flags in a separate bit vector that is indexed by text position
+// (bit i is set iff text[i - 1] < text[i]). All bits of the SA entries remain
+// available for indices (e.g., 32-bit SAs for texts of up to 4 GiB), and the
+// hot loops do not have to mask the entries. Each SACA call owns its own bit
+// vector, which is freed when the call returns (or throws).
+class flag_type_bitvector {
+  uint64_t *bits;
+
+public:
+  template<typename value_type>
+  flag_type_bitvector(value_type const *const text, size_t const n,
+                      size_t const threads = 1) {
+    size_t const words = (n + 63) >> 6;
+    bits = (uint64_t *) checked_malloc(words * sizeof(uint64_t));
+    #pragma omp parallel for num_threads(threads) if(threads > 1)
+    for (size_t w = 0; w < words; ++w) {
+      size_t const end = std::min(n, (w + 1) << 6);
+      uint64_t word = 0;
+      for (size_t i = std::max((size_t) 1, w << 6); i < end; ++i) {
+        word |= ((uint64_t) (text[i - 1] < text[i])) << (i & 63);
+      }
+      bits[w] = word;
+    }
+  }
+
+  // for texts that are not in memory: all bits are unset, and the caller
+  // sets them (see gsaca-double-sort-stream.hpp)
+  explicit flag_type_bitvector(size_t const n)
+      : bits((uint64_t *) checked_calloc((n + 63) >> 6, sizeof(uint64_t))) {}
+
+  flag_type_bitvector(flag_type_bitvector const &) = delete;
+  flag_type_bitvector &operator=(flag_type_bitvector const &) = delete;
+
+  ~flag_type_bitvector() {
+    free(bits);
+  }
+
+  inline void set(size_t const i) {
+    bits[i >> 6] |= 1ULL << (i & 63);
+  }
+
+  // the flags are already known from the text
+  template<typename T>
+  inline static T const &add_flag(T const &t) {
+    return t;
+  }
+
+  template<typename T>
+  inline static T const &conditional_add_flag(bool, T const &t) {
+    return t;
+  }
+
+  template<typename T>
+  inline static T const &remove_flag(T const &t) {
+    return t;
+  }
+
+  template<typename T>
+  inline bool is_flagged(T const &t) const {
+    uint64_t const i = (uint64_t) t;
+    return (bits[i >> 6] >> (i & 63)) & 1;
+  }
+};
+
+// values of the use_flags template parameter (false and true select
+// flag_type_none and flag_type_bitset)
+constexpr uint8_t flags_none = 0;
+constexpr uint8_t flags_bitset = 1;
+constexpr uint8_t flags_bitvector = 2;
+
+template<uint8_t use_flags>
 using flag_type = typename std::conditional<
-    use_flags, flag_type_bitset, flag_type_none>::type;
+    use_flags == flags_bitvector, flag_type_bitvector,
+    typename std::conditional<
+        use_flags == flags_bitset, flag_type_bitset,
+        flag_type_none>::type>::type;
 
 
 using std::uint8_t;
@@ -420,13 +506,17 @@ using uint48_t = uint_internal::UIntPair<uint16_t>;
 static_assert(sizeof(uint40_t) == 5, "sizeof uint40 is wrong");
 static_assert(sizeof(uint48_t) == 6, "sizeof uint48 is wrong");
 
+// By default, the buffer type equals the index type (32, 40 or 48 bits).
+// For 64-bit indices, 40 bits are used (i.e., texts of up to 512 GiB, or
+// 1 TiB without flags); use uint48_t indices (or buffer_type = uint48_t) for
+// larger texts.
 using auto_buffer_type = nullptr_t;
 template<typename buffer_type, typename index_type>
 using get_buffer_type =
 typename std::conditional<
     std::is_same_v<buffer_type, auto_buffer_type>,
     typename std::conditional<
-        (sizeof(index_type) > 5),
+        (sizeof(index_type) > 6),
         uint40_t,
         index_type>::type,
     buffer_type>::type;
@@ -446,6 +536,27 @@ template<typename uint_type, typename... uint_types>
 using get_count_type = typename std::conditional<
     ((sizeof_min<uint_type, uint_types...>()) > 4), uint64_t, uint32_t>::type;
 
+// Largest text length (incl. sentinels) for flag_type_bitset: the flag must
+// not collide with the most significant bit of the largest index. Longer
+// texts (e.g., between 2 GiB and 4 GiB for 32-bit SAs) use flag_type_bitvector.
+template<typename uint_type, typename... uint_types>
+constexpr uint64_t max_bitset_flags_n =
+    1ULL << ((sizeof_min<uint_type, uint_types...>() << 3) - 1);
+
+// Converts an SA entry between index_type and buffer_type (e.g., uint64_t and
+// uint40_t). Bitset flags are kept in the most significant bit of the target.
+template<typename F, typename target_type, typename source_type>
+inline static target_type convert_flagged(source_type const &t) {
+  if constexpr (std::is_same_v<target_type, source_type>) {
+    return t;
+  } else if constexpr (std::is_same_v<F, flag_type_bitset>) {
+    return F::conditional_add_flag(F::is_flagged(t),
+                                   (target_type) F::remove_flag(t));
+  } else {
+    return (target_type) t;
+  }
+}
+
 
 } // namespace gsaca_lyndon
 
@@ -512,7 +623,7 @@ public:
 };
 
 
-std::string to_string(gsaca_lyndon::uint128_t x) {
+inline std::string to_string(gsaca_lyndon::uint128_t x) {
   constexpr static uint64_t tenPow19 = 10000000000000000000ULL;
   uint64_t const low = x % tenPow19;
   x /= tenPow19;
@@ -530,7 +641,7 @@ std::string to_string(gsaca_lyndon::uint128_t x) {
   return s.str();
 }
 
-std::string to_string(gsaca_lyndon::int128_t const x) {
+inline std::string to_string(gsaca_lyndon::int128_t const x) {
   return (x < 0) ? ("-" + to_string((gsaca_lyndon::uint128_t) (-x)))
                  : to_string((gsaca_lyndon::uint128_t) (x));
 }
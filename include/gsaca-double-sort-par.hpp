@@ -4,6 +4,8 @@
 #include "common/timer.hpp"
 #include "common/util.hpp"
 #include "common/logging.hpp"
+#include "common/memory.hpp"
+#include "common/scatter.hpp"
 #include "parallel/phase_1.hpp"
 #include "parallel/phase_2.hpp"
 #include <algorithm>
@@ -15,6 +17,14 @@ namespace gsaca_lyndon {
 
 namespace double_sort_internal {
 
+// Border between the (i-1)-th and i-th of threads chunks of [0, n). Computed
+// with 64-bit arithmetic, since i * chunk may exceed n (and a 32-bit count
+// type) for texts close to 4 GiB.
+static inline size_t chunk_border(size_t const i, size_t const n,
+                                  size_t const threads) {
+  return std::min(n, i * (n / threads + (n % threads > 0)));
+}
+
 template<typename buffer_type, typename F,
          typename index_type, typename value_type>
 auto sort_by_prefix_parallel(value_type const *const text, index_type *const sa,
@@ -24,149 +34,225 @@ auto sort_by_prefix_parallel(value_type const *const text, index_type *const sa,
   using p1_group_type = typename p1_stack_type::value_type;
   p1_stack_type result;
 
-  if (sizeof(value_type) == 1) {
-    if (prefix == 1) {
-        std::vector<count_type> histogram_vec(256*threads);
-        count_type* const histogram_cont = histogram_vec.data();
-
-		// counting
-		#pragma omp parallel for
-		for (size_t i = 0; i < threads; ++i) {
-		   count_type interval_begin = std::max((count_type) (i * (n / threads + (n % threads > 0))), (count_type)1);
-		   count_type interval_end = std::min((count_type) ((i + 1) * (n / threads + (n % threads > 0))), n-1);
-		   count_type* histogram = &(histogram_cont[256*i]);
-
-		   for (count_type j = interval_begin; j < interval_end; ++j) {
-		       ++histogram[text[j]];
-		   }
-    	}
-
-		// calculate borders
-		count_type border = 2;
-		for (index_type i = 1; i < 256; ++i) {
-		    count_type gsize = 0;
-		    for (size_t j = 0; j < threads; ++j) {
-		        count_type bucket = 256*j+i;
-		        count_type count = histogram_cont[bucket];
-		        histogram_cont[bucket] = border;
-		        border += count;
-		        gsize += count;
-		    }
-		    if (gsize > 0 && i > 0) {
-		      result.emplace_back(p1_group_type{border-gsize, gsize, 1, true, false});
-		    }
-		}
-
-		// distribute
-		#pragma omp parallel for
-		for (size_t i = 0; i < threads; ++i) {
-		    count_type interval_begin = i * (n / threads + (n % threads > 0));
-		    count_type interval_end = std::min((count_type)((i + 1) * (n / threads + (n % threads > 0))), n);
-		    count_type* borders = &(histogram_cont[256*i]);
-
-		    for (count_type j = interval_begin; j < interval_end; ++j) {
-		        sa[borders[text[j]]++] = j;
-		    }
-		}
-  } else {
-      count_type const buckets = 1ULL << (prefix << 3);
-      std::vector<count_type> histogram_vec(buckets*threads);
-      count_type* const histogram_cont = histogram_vec.data();
-      count_type const stop = n - prefix - 1;
-
-      // counting
-      #pragma omp parallel for
-      for (size_t i = 0; i < threads; ++i) {
-          count_type interval_begin = std::max((count_type) (i * (n / threads + (n % threads > 0))), (count_type)1);
-          count_type interval_end = std::min((count_type) ((i + 1) * (n / threads + (n % threads > 0))), stop);
-          count_type* histogram = &(histogram_cont[buckets*i]);
-
-          for (count_type j = interval_begin; j < interval_end; ++j) {
-              ++histogram[extract(text, j, prefix)];
-          }
-      }
-      {
-          count_type* histogram = &(histogram_cont[buckets*(threads-1)]);
-          for (count_type i = stop; i < n - 1; ++i) {
-            ++histogram[safe_extract(text, i, prefix)];
+  // 16-bit characters are bucketed by a dense counting sort as well (prefix 1
+  // only, longer prefixes use the comparison sort below). Wider characters
+  // always use the comparison sort, their histograms would not fit.
+  if constexpr (sizeof(value_type) <= 2) {
+    if (sizeof(value_type) == 1 || prefix == 1) {
+      if (prefix == 1) {
+          constexpr uint64_t sigma =
+              1ULL << (sizeof(value_type) * 8);
+          std::vector<count_type> histogram_vec(sigma*threads);
+          count_type* const histogram_cont = histogram_vec.data();
+
+          // counting
+          #pragma omp parallel for
+          for (size_t i = 0; i < threads; ++i) {
+             count_type interval_begin = std::max(chunk_border(i, n, threads), (size_t)1);
+             count_type interval_end = std::min(chunk_border(i + 1, n, threads), (size_t)n-1);
+             count_type* histogram = &(histogram_cont[sigma*i]);
+
+             for (count_type j = interval_begin; j < interval_end; ++j) {
+                 ++histogram[text[j]];
+             }
           }
-      }
 
-      // calculate borders
-      count_type border = 2;
-      for (count_type i = buckets >> 8; i < buckets; ++i) {
-          count_type gsize = 0;
-          for (size_t j = 0; j < threads; ++j) {
-              count_type bucket = buckets*j+i;
-              count_type count = histogram_cont[bucket];
-              histogram_cont[bucket] = border;
-              border += count;
-              gsize += count;
-          }
-          if (gsize > 0 && i > 0) {
-            result.emplace_back(p1_group_type{border-gsize, gsize, 1, true, false});
+          // calculate borders
+          count_type border = 2;
+          for (uint64_t i = 1; i < sigma; ++i) {
+              count_type gsize = 0;
+              for (size_t j = 0; j < threads; ++j) {
+                  size_t bucket = sigma*j+i;
+                  count_type count = histogram_cont[bucket];
+                  histogram_cont[bucket] = border;
+                  border += count;
+                  gsize += count;
+              }
+              if (gsize > 0 && i > 0) {
+                result.emplace_back(p1_group_type{border-gsize, gsize, 1, true, false});
+              }
           }
-      }
 
-      // distribute
-      #pragma omp parallel for
-      for (size_t i = 0; i < threads; ++i) {
-          count_type interval_begin = std::max(i * (n / threads + (n % threads > 0)), (size_t)1);
-          count_type interval_end = std::min((count_type)((i + 1) * (n / threads + (n % threads > 0))), stop);
-          count_type* borders = &(histogram_cont[buckets*i]);
+          // distribute
+          #pragma omp parallel for
+          for (size_t i = 0; i < threads; ++i) {
+              count_type interval_begin = chunk_border(i, n, threads);
+              count_type interval_end = chunk_border(i + 1, n, threads);
+              count_type* borders = &(histogram_cont[sigma*i]);
 
-          for (count_type j = interval_begin; j < interval_end; ++j) {
-              sa[borders[extract(text, j, prefix)]++] = F::conditional_add_flag(
-                          text[j - 1] < text[j], j);
-          }
-      }
-      {
-          count_type* borders = &(histogram_cont[buckets*(threads-1)]);
-          for (count_type i = stop; i < n - 1; ++i) {
-              sa[borders[safe_extract(text, i, prefix)]++] = F::conditional_add_flag(
-                          text[i - 1] < text[i], i);
+              for (count_type j = interval_begin; j < interval_end; ++j) {
+                  sa[borders[text[j]]++] = j;
+              }
           }
+      } else {
+        // If the keys have more than 16 bits, the characters are mapped to the
+        // codes 1, ..., sigma (0 remains the sentinel) and packed with
+        // ceil(log2(sigma + 1)) bits each (as in sort_by_reduced_prefix). Keys
+        // of at most 16 bits are bucketed with one histogram per thread, larger
+        // keys by two-level bucketing with a single histogram (see
+        // blocked_bucket_parallel). Either way, there are no 2^24 counters per
+        // thread.
+        uint8_t code[256];
+        uint8_t bits = 8;
+        for (uint64_t c = 0; c < 256; ++c) {
+            code[c] = c;
+        }
+        if (bits * prefix > 16) {
+            std::vector<count_type> char_histograms(256 * threads);
+            #pragma omp parallel for
+            for (size_t i = 0; i < threads; ++i) {
+                count_type* histogram = &(char_histograms[256 * i]);
+                for (count_type j = chunk_border(i, n, threads); j < chunk_border(i + 1, n, threads); ++j) {
+                    ++histogram[text[j]];
+                }
+            }
+            uint8_t sigma = 0;
+            uint8_t reduced_code[256] = {};
+            for (uint64_t c = 1; c < 256; ++c) {
+                bool used = false;
+                for (size_t i = 0; i < threads; ++i) {
+                    used = used || (char_histograms[256 * i + c] > 0);
+                }
+                if (used) reduced_code[c] = ++sigma;
+            }
+            uint8_t const reduced_bits = 64 - __builtin_clzll(sigma | 1);
+            if (reduced_bits * prefix <= 16) {
+                std::copy(reduced_code, reduced_code + 256, code);
+                bits = reduced_bits;
+            }
+        }
+        uint8_t const key_bits = bits * prefix;
+        count_type const buckets = 1ULL << key_bits;
+        count_type const stop = (n > (count_type) prefix + 2) ? n - prefix - 1 : 1;
+
+        auto const value_of = [&](count_type const i) {
+            return F::conditional_add_flag(text[i - 1] < text[i], (index_type) i);
+        };
+
+        if (key_bits <= 16) {
+            uint64_t const mask = buckets - 1;
+            auto const code_at = [&](uint64_t const j) -> uint64_t {
+                return (j < n) ? code[text[j]] : 0;
+            };
+            auto const first_key = [&](count_type const i) {
+                uint64_t key = 0;
+                for (uint64_t j = i; j < (uint64_t) i + prefix; ++j) {
+                    key = (key << bits) | code_at(j);
+                }
+                return key;
+            };
+
+            std::vector<count_type> histogram_vec(buckets*threads);
+            count_type* const histogram_cont = histogram_vec.data();
+
+            // counting
+            #pragma omp parallel for
+            for (size_t i = 0; i < threads; ++i) {
+                count_type interval_begin = std::max(chunk_border(i, n, threads), (size_t)1);
+                count_type interval_end = std::min(chunk_border(i + 1, n, threads), (size_t)n-1);
+                count_type* histogram = &(histogram_cont[buckets*i]);
+
+                uint64_t key = first_key(interval_begin);
+                for (count_type j = interval_begin; j < interval_end; ++j) {
+                    ++histogram[key];
+                    key = ((key << bits) | code_at((uint64_t) j + prefix)) & mask;
+                }
+            }
+
+            // calculate borders
+            count_type border = 2;
+            for (count_type i = 0; i < buckets; ++i) {
+                count_type gsize = 0;
+                for (size_t j = 0; j < threads; ++j) {
+                    size_t bucket = buckets*j+i;
+                    count_type count = histogram_cont[bucket];
+                    histogram_cont[bucket] = border;
+                    border += count;
+                    gsize += count;
+                }
+                if (gsize > 0) {
+                  result.emplace_back(p1_group_type{border-gsize, gsize, 1, true, false});
+                }
+            }
+
+            // distribute
+            #pragma omp parallel for
+            for (size_t i = 0; i < threads; ++i) {
+                count_type interval_begin = std::max(chunk_border(i, n, threads), (size_t)1);
+                count_type interval_end = std::min(chunk_border(i + 1, n, threads), (size_t)n-1);
+                count_type* borders = &(histogram_cont[buckets*i]);
+
+                uint64_t key = first_key(interval_begin);
+                for (count_type j = interval_begin; j < interval_end; ++j) {
+                    sa[borders[key]++] = value_of(j);
+                    key = ((key << bits) | code_at((uint64_t) j + prefix)) & mask;
+                }
+            }
+        } else {
+            std::vector<count_type> histogram_vec(buckets);
+            count_type* const borders = histogram_vec.data();
+            blocked_bucket_parallel(sa, borders, key_bits, (count_type) 1, n - 1,
+                    (count_type) 2,
+                    [&](count_type const i) -> uint64_t {
+                        return (i < stop) ? (uint64_t) extract(text, i, prefix)
+                                          : (uint64_t) safe_extract(text, i, prefix);
+                    }, value_of, threads);
+
+            // borders[b] is now the right border of bucket b
+            count_type left_border = 2;
+            for (count_type b = 0; b < buckets; ++b) {
+                if (borders[b] > left_border) {
+                  result.emplace_back(p1_group_type{left_border, borders[b] - left_border, 1, true, false});
+                }
+                left_border = borders[b];
+            }
+        }
       }
+      sa[0] = n - 1;
+      sa[1] = 0;
+      return result;
+    }
   }
-}
-  else {
-      // fill sa with values
-      #pragma omp parallel for
-      for (count_type i = 0; i < n; ++i) {
-          sa[i] = i;
-      }
 
-      // sort sa by first character
-      auto comp = [&](auto a, auto b) {
-           auto extracted1 = safe_extract(text, a, prefix);
-           auto extracted2 = safe_extract(text, b, prefix);
-           return (extracted1 < extracted2) || ((extracted1 == extracted2) && a < b);
-      };
-      ips4o::parallel::sort(&(sa[0]), &(sa[n]), comp);
-
-      // determine gsizes
-      // TODO: Parallelize
-      count_type left_border = 2;
-      count_type gsize = 1;
-      for (count_type i = 2; i < n-1; ++i) {
-          if (safe_extract(text, sa[i], prefix) == safe_extract(text, sa[i+1], prefix)) {
-              ++gsize;
-          }
-          else {
-              result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
-              left_border = i+1;
-              gsize = 1;
-          }
-      }
-      result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+  // fill sa with values; the sentinel n - 1 is excluded from sorting,
+  // since safe_extract would read behind it
+  sa[0] = n - 1;
+  #pragma omp parallel for
+  for (count_type i = 0; i < n - 1; ++i) {
+      sa[i + 1] = i;
+  }
 
-      // add flags
-      #pragma omp parallel for
-      for (count_type i = 0; i < n; ++i) {
-          auto idx = sa[i];
-          sa[i] = (idx != 0) ? F::conditional_add_flag(text[idx - 1] < text[idx], idx) : idx;
+  // sort sa by first character
+  auto comp = [&](auto a, auto b) {
+       auto extracted1 = safe_extract(text, a, prefix);
+       auto extracted2 = safe_extract(text, b, prefix);
+       return (extracted1 < extracted2) || ((extracted1 == extracted2) && a < b);
+  };
+  ips4o::parallel::sort(&(sa[1]), &(sa[n]), comp);
+
+  // determine gsizes
+  // TODO: Parallelize
+  count_type left_border = 2;
+  count_type gsize = 1;
+  for (count_type i = 2; i < n-1; ++i) {
+      if (safe_extract(text, sa[i], prefix) == safe_extract(text, sa[i+1], prefix)) {
+          ++gsize;
+      }
+      else {
+          result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+          left_border = i+1;
+          gsize = 1;
       }
   }
+  result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+
+  // add flags
+  #pragma omp parallel for
+  for (count_type i = 0; i < n; ++i) {
+      auto idx = sa[i];
+      sa[i] = (idx != 0) ? F::conditional_add_flag(text[idx - 1] < text[idx], idx) : idx;
+  }
+
   sa[0] = n - 1;
   sa[1] = 0;
   return result;
@@ -175,7 +261,7 @@ auto sort_by_prefix_parallel(value_type const *const text, index_type *const sa,
 }
 
 template<typename buffer_type = auto_buffer_type,
-    bool use_flags = true,
+    uint8_t use_flags = flags_bitset,
     typename index_type, // auto deduce
     typename value_type, // auto deduce
     typename used_buffer_type = get_buffer_type <buffer_type, index_type>>
@@ -188,6 +274,17 @@ gsaca_ds_par(value_type const *const text, index_type *const sa, size_t const n,
   static_assert(check_buffer_type<buffer_type, index_type, used_buffer_type>);
   //static_assert(sizeof(value_type) == 1);
 
+  if constexpr (use_flags == flags_bitset) {
+    constexpr uint64_t max_n = max_bitset_flags_n<index_type, used_buffer_type>;
+    if (gsaca_unlikely(n > max_n)) {
+      LOG_VERBOSE << "Text too long for flags in the SA, use bit vector."
+                  << std::endl;
+      gsaca_ds_par<buffer_type, flags_bitvector>(text, sa, n, threads,
+                                                 initial_sort_prefix_len);
+      return;
+    }
+  }
+
   using F = flag_type<use_flags>;
 
   size_t p_max = omp_get_max_threads();
@@ -201,10 +298,12 @@ gsaca_ds_par(value_type const *const text, index_type *const sa, size_t const n,
 
   LOG_VERBOSE << "\n\nStart SACA..." << std::endl;
 
+  F const flags(text, n, threads);
   auto p1_input_groups =
       double_sort_internal::sort_by_prefix_parallel<used_buffer_type, F>
             (text, sa, n, initial_sort_prefix_len, threads);
-  used_buffer_type *const isa = (used_buffer_type *) malloc(n * sizeof(used_buffer_type));
+  used_buffer_type *const isa = (used_buffer_type *) checked_malloc(n * sizeof(used_buffer_type));
+  scoped_free isa_guard(isa);
   time2.end();
   LOG_VERBOSE << "Prepared phase 1: " << time2.throughput_string(n)
               << std::endl;
@@ -222,8 +321,8 @@ gsaca_ds_par(value_type const *const text, index_type *const sa, size_t const n,
 
   time1.begin();
   phase_2_by_sorting_stable_parallel<F>(sa, isa, n, p2_input_groups.data(),
-                     p2_input_groups.size(), threads);
-  free(isa);
+                     p2_input_groups.size(), threads, flags);
+  isa_guard.reset();
   time1.end();
 
   LOG_VERBOSE << "Phase 2 (incl. free isa): " << time1.throughput_string(n)
@@ -239,7 +338,7 @@ template<typename buffer_type = auto_buffer_type,
     typename value_type>
 static void gsaca_ds1_par(value_type const *const text, index_type *const sa,
                       size_t const n, size_t const threads) {
-  gsaca_ds_par<buffer_type, false>(text, sa, n, threads, 1);
+  gsaca_ds_par<buffer_type, flags_none>(text, sa, n, threads, 1);
 }
 
 template<typename buffer_type = auto_buffer_type,
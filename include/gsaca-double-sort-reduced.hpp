@@ -0,0 +1,267 @@
+#pragma once
+
+#include "gsaca-double-sort.hpp"
+#include <cstdlib>
+#include <limits>
+
+namespace gsaca_lyndon {
+
+// gsaca_ds on a reduced text, for byte texts with long Lyndon words (where
+// phase 1 has to refine the initial groups many times). A position i is
+// L-type if its longest Lyndon word has length 1 (i.e., the suffix at i + 1
+// is smaller than the suffix at i) and S-type otherwise. The leftmost S-type
+// positions (LMS) split the text into factors, which are sorted by induced
+// sorting (as in SA-IS) and replaced by their ranks. This reduced text has at
+// most half the length; it is suffix sorted by gsaca_ds, and its suffix array
+// induces the suffix array of the text (again as in SA-IS).
+
+namespace reduced_internal {
+
+struct type_bits {
+  uint64_t *bits;
+
+  gsaca_always_inline bool is_s(uint64_t const i) const {
+    return (bits[i >> 6] >> (i & 63)) & 1;
+  }
+
+  gsaca_always_inline bool is_lms(uint64_t const i) const {
+    return i > 0 && is_s(i) && !is_s(i - 1);
+  }
+};
+
+// Classifies the positions of s[0, n), where s[n - 1] is the unique
+// smallest character.
+template<typename value_type>
+type_bits classify(value_type const *const s, uint64_t const n) {
+  type_bits types{
+      (uint64_t *) checked_calloc((n >> 6) + 1, sizeof(uint64_t))};
+  types.bits[(n - 1) >> 6] |= 1ULL << ((n - 1) & 63);
+  bool s_type = true;
+  for (uint64_t i = n - 1; i-- > 0;) {
+    s_type = (s[i] < s[i + 1]) || (s[i] == s[i + 1] && s_type);
+    types.bits[i >> 6] |= ((uint64_t) s_type) << (i & 63);
+  }
+  return types;
+}
+
+// Induces the L-type and then the S-type suffixes from the LMS suffixes,
+// which have to be at the ends of their buckets.
+template<typename index_type, typename value_type>
+void induce(value_type const *const s, index_type *const sa, uint64_t const n,
+            type_bits const &types, uint64_t const *const histogram) {
+  uint64_t const empty = std::numeric_limits<index_type>::max();
+  uint64_t bucket[256];
+
+  uint64_t sum = 0;
+  for (uint64_t c = 0; c < 256; ++c) {
+    bucket[c] = sum;
+    sum += histogram[c];
+  }
+  for (uint64_t k = 0; k < n; ++k) {
+    uint64_t const v = sa[k];
+    if (v != empty && v > 0 && !types.is_s(v - 1)) {
+      sa[bucket[s[v - 1]]++] = (index_type) (v - 1);
+    }
+  }
+
+  for (uint64_t c = 0; c < 256; ++c) {
+    sum -= histogram[c];
+  }
+  for (uint64_t c = 0; c < 256; ++c) {
+    sum += histogram[c];
+    bucket[c] = sum;
+  }
+  for (uint64_t k = n; k-- > 0;) {
+    uint64_t const v = sa[k];
+    if (v != empty && v > 0 && types.is_s(v - 1)) {
+      sa[--bucket[s[v - 1]]] = (index_type) (v - 1);
+    }
+  }
+}
+
+// places the sorted LMS suffixes sa[0, m) at the ends of their buckets
+template<typename index_type, typename value_type>
+void place_lms(value_type const *const s, index_type *const sa,
+               uint64_t const n, uint64_t const m,
+               uint64_t const *const histogram) {
+  index_type const empty = std::numeric_limits<index_type>::max();
+  uint64_t bucket[256];
+  uint64_t sum = 0;
+  for (uint64_t c = 0; c < 256; ++c) {
+    sum += histogram[c];
+    bucket[c] = sum;
+  }
+  for (uint64_t k = m; k < n; ++k) {
+    sa[k] = empty;
+  }
+  for (uint64_t k = m; k-- > 0;) {
+    uint64_t const p = sa[k];
+    sa[k] = empty;
+    sa[--bucket[s[p]]] = (index_type) p;
+  }
+}
+
+// The reduced text (names of the LMS factors in text order, enclosed by
+// sentinels) is sorted by gsaca_ds. Afterwards, sa[0, m) contains the sorted
+// LMS positions.
+template<typename p1_sorter, typename p2_sorter, typename name_type,
+    typename index_type>
+void sort_reduced(index_type *const sa, uint64_t const n, uint64_t const m,
+                  uint64_t const names, type_bits const &types) {
+  name_type *const reduced =
+      (name_type *) checked_malloc((m + 1) * sizeof(name_type));
+  scoped_free const reduced_guard(reduced);
+  name_type *const reduced_sa =
+      (name_type *) checked_malloc((m + 1) * sizeof(name_type));
+  scoped_free const reduced_sa_guard(reduced_sa);
+
+  // the names are stored (in text order) in sa[n - m, n)
+  reduced[0] = 0;
+  for (uint64_t t = 0; t < m; ++t) {
+    reduced[t + 1] = (name_type) (uint64_t) sa[n - m + t];
+  }
+
+  if (names == m) {
+    // all factors are distinct, the names are the ranks
+    reduced_sa[0] = m;
+    reduced_sa[1] = 0;
+    for (uint64_t t = 1; t < m; ++t) {
+      reduced_sa[reduced[t] + 1] = t;
+    }
+  } else {
+    LOG_VERBOSE << "Sort reduced text of length " << m << " ("
+                << names << " names)." << std::endl;
+    gsaca_ds<p1_sorter, p2_sorter>(reduced, reduced_sa, m + 1, 1);
+  }
+
+  // reduced now holds the LMS positions in text order
+  uint64_t t = 0;
+  for (uint64_t i = 1; i < n; ++i) {
+    if (types.is_lms(i)) reduced[t++] = i;
+  }
+  sa[0] = n - 1;
+  for (uint64_t k = 2; k <= m; ++k) {
+    sa[k - 1] = (index_type) (uint64_t) reduced[reduced_sa[k] - 1];
+  }
+}
+
+} // namespace reduced_internal
+
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename index_type, // auto deduce
+    typename value_type> // auto deduce
+static void gsaca_ds_reduced(value_type const *const text,
+                             index_type *const sa, size_t const n) {
+  static_assert(sizeof(value_type) == 1);
+  static_assert(std::is_unsigned<index_type>::value);
+  using namespace reduced_internal;
+
+  if (gsaca_unlikely(n < 3)) {
+    for (size_t i = 0; i < n; ++i) sa[i] = (index_type) (n - 1 - i);
+    return;
+  }
+
+  timer time;
+  time.begin();
+  LOG_VERBOSE << "\n\nStart SACA (reduced)..." << std::endl;
+
+  // sort s = text[1, n), which ends with the unique smallest character
+  value_type const *const s = text + 1;
+  index_type *const s_sa = sa + 1;
+  uint64_t const s_n = n - 1;
+  index_type const empty = std::numeric_limits<index_type>::max();
+
+  uint64_t histogram[256] = {};
+  for (uint64_t i = 0; i < s_n; ++i) {
+    ++histogram[s[i]];
+  }
+  type_bits const types = classify(s, s_n);
+  scoped_free types_guard(types.bits);
+
+  // sort the LMS factors (the LMS positions are put into their buckets in
+  // any order)
+  uint64_t m = 0;
+  {
+    uint64_t bucket[256];
+    uint64_t sum = 0;
+    for (uint64_t c = 0; c < 256; ++c) {
+      sum += histogram[c];
+      bucket[c] = sum;
+    }
+    for (uint64_t j = 0; j < s_n; ++j) {
+      s_sa[j] = empty;
+    }
+    for (uint64_t i = 1; i < s_n; ++i) {
+      if (types.is_lms(i)) {
+        s_sa[--bucket[s[i]]] = (index_type) i;
+        ++m;
+      }
+    }
+  }
+  induce(s, s_sa, s_n, types, histogram);
+
+  // name the factors
+  uint64_t k = 0;
+  for (uint64_t j = 0; j < s_n; ++j) {
+    uint64_t const p = s_sa[j];
+    if (types.is_lms(p)) s_sa[k++] = (index_type) p;
+  }
+  for (uint64_t j = m; j < s_n; ++j) {
+    s_sa[j] = empty;
+  }
+  uint64_t names = 0;
+  uint64_t previous = 0;
+  for (uint64_t j = 0; j < m; ++j) {
+    uint64_t const p = s_sa[j];
+    bool different = (j == 0);
+    for (uint64_t d = 0; !different; ++d) {
+      if (s[p + d] != s[previous + d] ||
+          types.is_s(p + d) != types.is_s(previous + d)) {
+        different = true;
+      } else if (d > 0 && (types.is_lms(p + d) ||
+                           types.is_lms(previous + d))) {
+        different = !(types.is_lms(p + d) && types.is_lms(previous + d));
+        break;
+      }
+    }
+    names += different;
+    previous = p;
+    // LMS positions are at least two apart
+    s_sa[m + (p >> 1)] = (index_type) (names - 1);
+  }
+  for (uint64_t i = s_n, j = s_n; i-- > m;) {
+    if ((uint64_t) s_sa[i] != (uint64_t) empty) s_sa[--j] = s_sa[i];
+  }
+
+  time.end();
+  LOG_VERBOSE << "Reduced text: " << abs_and_rel_string(m, s_n) << ", names: "
+              << names << ", " << time.throughput_string(n) << std::endl;
+  LOG_STATS << "reduce" << time.millis();
+
+  time.begin();
+  // the names and the LMS positions have to fit
+  if (s_n < std::numeric_limits<uint32_t>::max()) {
+    sort_reduced<p1_sorter, p2_sorter, uint32_t>(s_sa, s_n, m, names, types);
+  } else {
+    sort_reduced<p1_sorter, p2_sorter, uint64_t>(s_sa, s_n, m, names, types);
+  }
+  time.end();
+  LOG_STATS << "recursion" << time.millis();
+
+  time.begin();
+  place_lms(s, s_sa, s_n, m, histogram);
+  induce(s, s_sa, s_n, types, histogram);
+  types_guard.reset();
+
+  // positions in s are positions in the text minus one
+  for (size_t j = 2; j < n; ++j) {
+    sa[j] = (index_type) ((uint64_t) sa[j] + 1);
+  }
+  sa[0] = n - 1;
+  sa[1] = 0;
+  time.end();
+  LOG_VERBOSE << "Induced: " << time.throughput_string(n) << std::endl;
+  LOG_STATS << "induce" << time.millis();
+}
+
+} // namespace gsaca_lyndon
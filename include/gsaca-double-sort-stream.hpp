@@ -0,0 +1,263 @@
+#pragma once
+
+#include "gsaca-double-sort.hpp"
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <stdexcept>
+
+namespace gsaca_lyndon {
+
+// gsaca_ds for byte texts that are not in memory, or that are in memory but
+// must not be modified (e.g., read-only mappings of files). The text is read
+// exactly once, in chunks, and neither copied nor modified; the sentinels are
+// virtual. The characters are mapped to the codes 1, ..., 256
+// (0 is the sentinel), i.e., the text may contain all 256 characters. The
+// resulting SA is the SA of the sentinel-enclosed text: it has n + 2 entries,
+// and the suffix starting with the i-th character (0-based) is i + 1.
+
+namespace double_sort_stream_internal {
+
+// characters per chunk
+constexpr size_t chunk_size = 1ULL << 16;
+// bits per character code (256 characters and the sentinel)
+constexpr uint8_t code_bits = 9;
+
+// Initial grouping by prefixes of length 1 or 2. While the text is read, the
+// prefix code and the flag of each position are stored in the (otherwise
+// unused) ISA, and the histogram is computed. Then the positions are moved
+// into their buckets. The source is called as next(max) and returns the next
+// chunk of the text as pair (pointer, length) with 0 < length <= max.
+template<typename buffer_type, typename F, uint8_t use_flags,
+    typename index_type, typename source_type>
+auto sort_by_prefix_stream(source_type &next, index_type *const sa,
+                           buffer_type *const keys, F &flags,
+                           get_count_type<index_type, buffer_type> const n,
+                           uint8_t const prefix) {
+  using count_type = get_count_type<index_type, buffer_type>;
+  using p1_stack_type = phase_1_stack_type<buffer_type>;
+  using p1_group_type = typename p1_stack_type::value_type;
+
+  uint64_t const key_bits = code_bits * prefix;
+  uint64_t const mask = (1ULL << key_bits) - 1;
+  std::vector<count_type> histogram(1ULL << key_bits);
+
+  // keys[i] = (prefix code of position i) << 1 | flag of position i
+  uint64_t key = 0;
+  uint64_t previous = 0;
+  count_type i = 1;
+  while (i < n - 1) {
+    auto const[chunk, length] = next((size_t) (n - 1 - i));
+    if (gsaca_unlikely(length == 0)) {
+      throw std::length_error(
+          "gsaca_lyndon::gsaca_ds_stream: text ended early");
+    }
+    for (size_t j = 0; j < length; ++i, ++j) {
+      uint64_t const code = (uint64_t) chunk[j] + 1;
+      keys[i] = (buffer_type) (previous < code);
+      if constexpr (use_flags == flags_bitvector) {
+        if (previous < code) flags.set(i);
+      }
+      previous = code;
+      key = ((key << code_bits) | code) & mask;
+      // the key of position i - prefix + 1 is complete
+      if (i >= prefix) {
+        count_type const pos = i - prefix + 1;
+        keys[pos] = (buffer_type) ((key << 1) | (keys[pos] & 1));
+        ++histogram[key];
+      }
+    }
+  }
+  // the remaining keys end with the sentinel
+  for (count_type pos = std::max((count_type) 1, (count_type) (n - prefix));
+       pos < n - 1; ++pos) {
+    key = (key << code_bits) & mask;
+    keys[pos] = (buffer_type) ((key << 1) | (keys[pos] & 1));
+    ++histogram[key];
+  }
+
+  p1_stack_type result;
+  count_type *const borders = histogram.data();
+  count_type left_border = 2;
+  for (uint64_t b = 1ULL << (key_bits - code_bits); b <= mask; ++b) {
+    count_type const gsize = histogram[b];
+    borders[b] = left_border;
+    if (gsize > 0) {
+      result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+    }
+    left_border += gsize;
+  }
+
+  for (count_type pos = 1; pos < n - 1; ++pos) {
+    sa[borders[keys[pos] >> 1]++] =
+        F::conditional_add_flag(keys[pos] & 1, (index_type) pos);
+  }
+  sa[0] = n - 1;
+  sa[1] = 0;
+  return result;
+}
+
+// gsaca_ds for a text that is given chunk by chunk (see sort_by_prefix_stream)
+template<typename p1_sorter, typename p2_sorter, typename buffer_type,
+    uint8_t use_flags, typename index_type, typename source_type,
+    typename used_buffer_type = get_buffer_type <buffer_type, index_type>>
+static void gsaca_ds_chunks(source_type &&next, index_type *const sa,
+                            size_t const text_n,
+                            size_t const initial_sort_prefix_len) {
+  static_assert(std::is_unsigned<index_type>::value);
+  static_assert(std::is_unsigned<used_buffer_type>::value);
+  static_assert(check_buffer_type<buffer_type, index_type, used_buffer_type>);
+  // keys of two characters and a flag
+  static_assert(sizeof(used_buffer_type) >= 4);
+
+  // the SA (and the ISA) have to address all positions incl. the sentinels
+  uint64_t const max_n =
+      std::min((uint64_t) std::numeric_limits<index_type>::max(),
+               (uint64_t) PTRDIFF_MAX / sizeof(used_buffer_type));
+  if (gsaca_unlikely(text_n > max_n - 2)) {
+    throw std::length_error(
+        "gsaca_lyndon::gsaca_ds_stream: text too long for the index type");
+  }
+  size_t const n = text_n + 2;
+  if (gsaca_unlikely(text_n == 0)) {
+    sa[0] = 1;
+    sa[1] = 0;
+    return;
+  }
+  uint8_t const prefix = std::min((size_t) 2,
+                                  std::max((size_t) 1, initial_sort_prefix_len));
+
+  if constexpr (use_flags == flags_bitset) {
+    constexpr uint64_t max_n = max_bitset_flags_n<index_type, used_buffer_type>;
+    if (gsaca_unlikely(n > max_n)) {
+      LOG_VERBOSE << "Text too long for flags in the SA, use bit vector."
+                  << std::endl;
+      gsaca_ds_chunks<p1_sorter, p2_sorter, buffer_type, flags_bitvector>(
+          next, sa, text_n, prefix);
+      return;
+    }
+  }
+
+  using F = flag_type<use_flags>;
+
+  timer time1;
+  timer time2;
+  time1.begin();
+  time2.begin();
+  LOG_VERBOSE << "\n\nStart SACA (streaming)..." << std::endl;
+
+  // (the bit vector is filled while the text is read)
+  F flags(n);
+  // the ISA holds the prefix codes until phase 1 starts
+  used_buffer_type *const isa =
+      (used_buffer_type *) checked_malloc(n * sizeof(used_buffer_type));
+  // the source may end early or throw (the ISA and bit vector free themselves)
+  scoped_free isa_guard(isa);
+  auto p1_input_groups =
+      double_sort_stream_internal::sort_by_prefix_stream<used_buffer_type, F,
+          use_flags>(next, sa, isa, flags, n, prefix);
+
+  time2.end();
+  LOG_VERBOSE << "Prepared phase 1: " << time2.throughput_string(n)
+              << std::endl;
+  LOG_STATS << "initial_buckets" << time2.millis();
+
+  time2.begin();
+  auto p2_input_groups = phase_1_by_sorting<p1_sorter, F>(sa, isa,
+                                                          p1_input_groups);
+  time2.end();
+  time1.end();
+  LOG_VERBOSE << "Phase 1 (excl. prepare):  " << time2.throughput_string(n)
+              << "\n" << "Phase 1 (incl. prepare):  "
+              << time1.throughput_string(n) << std::endl;
+  LOG_STATS << "phase1" << time2.millis();
+
+
+  time1.begin();
+  phase_2_by_sorting<p2_sorter, F>(sa, isa, n, p2_input_groups.data(),
+                                   p2_input_groups.size(), flags);
+  isa_guard.reset();
+  time1.end();
+
+  LOG_VERBOSE << "Phase 2 (incl. free isa): " << time1.throughput_string(n)
+              << std::endl;
+  LOG_STATS << "phase2" << time1.millis();
+}
+
+} // namespace double_sort_stream_internal
+
+// The reader is called as read(uint8_t *buffer, size_t max) and returns the
+// number of characters (at most max, at least one) that were written to the
+// buffer. The text has n characters (without sentinels), and the SA has to
+// provide space for n + 2 entries. Only initial prefixes of length 1 and 2
+// are supported.
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename buffer_type = auto_buffer_type,
+    uint8_t use_flags = flags_bitset,
+    typename index_type, // auto deduce
+    typename reader_type> // auto deduce
+static void gsaca_ds_stream(reader_type &&read, index_type *const sa,
+                            size_t const text_n,
+                            size_t const initial_sort_prefix_len = 2) {
+  using namespace double_sort_stream_internal;
+  std::vector<uint8_t> chunk(chunk_size);
+  gsaca_ds_chunks<p1_sorter, p2_sorter, buffer_type, use_flags>(
+      [&](size_t const max) {
+          size_t const length = read(chunk.data(), std::min(chunk_size, max));
+          return std::make_pair((uint8_t const *) chunk.data(), length);
+      }, sa, text_n, initial_sort_prefix_len);
+}
+
+// Sorts the raw text[0, n) in place, i.e., without sentinels, without copying
+// and without modifying the text (which may, e.g., be a read-only mapping of
+// a file). The SA has to provide space for n + 2 entries.
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename buffer_type = auto_buffer_type,
+    uint8_t use_flags = flags_bitset,
+    typename index_type> // auto deduce
+static void gsaca_ds_raw(uint8_t const *const text, index_type *const sa,
+                         size_t const text_n,
+                         size_t const initial_sort_prefix_len = 2) {
+  uint8_t const *position = text;
+  double_sort_stream_internal::gsaca_ds_chunks<p1_sorter, p2_sorter,
+      buffer_type, use_flags>(
+      [&](size_t const max) {
+          uint8_t const *const chunk = position;
+          position += max;
+          return std::make_pair(chunk, max);
+      }, sa, text_n, initial_sort_prefix_len);
+}
+
+// Reads the n characters from an input iterator.
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename buffer_type = auto_buffer_type,
+    typename index_type, // auto deduce
+    typename input_iterator>
+static void gsaca_ds_iterator(input_iterator first, index_type *const sa,
+                              size_t const text_n,
+                              size_t const initial_sort_prefix_len = 2) {
+  gsaca_ds_stream<p1_sorter, p2_sorter, buffer_type>(
+      [&](uint8_t *const buffer, size_t const max) {
+          for (size_t i = 0; i < max; ++i, ++first) {
+            buffer[i] = (uint8_t) *first;
+          }
+          return max;
+      }, sa, text_n, initial_sort_prefix_len);
+}
+
+// Reads the n characters from a stream (e.g., a std::ifstream opened in
+// binary mode).
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename buffer_type = auto_buffer_type,
+    typename index_type> // auto deduce
+static void gsaca_ds_istream(std::istream &stream, index_type *const sa,
+                             size_t const text_n,
+                             size_t const initial_sort_prefix_len = 2) {
+  gsaca_ds_stream<p1_sorter, p2_sorter, buffer_type>(
+      [&](uint8_t *const buffer, size_t const max) {
+          stream.read((char *) buffer, max);
+          return (size_t) stream.gcount();
+      }, sa, text_n, initial_sort_prefix_len);
+}
+
+} // namespace gsaca_lyndon
@@ -4,6 +4,8 @@
 #include "common/timer.hpp"
 #include "common/util.hpp"
 #include "common/logging.hpp"
+#include "common/memory.hpp"
+#include "common/scatter.hpp"
 #include "sequential/phase_1.hpp"
 #include "sequential/phase_2.hpp"
 #include <algorithm>
@@ -15,6 +17,175 @@ namespace gsaca_lyndon {
 
 namespace double_sort_internal {
 
+// largest dense histogram (in bits) used by sort_by_reduced_prefix
+constexpr uint8_t max_dense_prefix_bits = 24;
+
+// Initial grouping by prefixes of length k (k > 3) for byte alphabets. The
+// characters are mapped to the codes 1, ..., sigma (0 remains the sentinel)
+// and packed with ceil(log2(sigma + 1)) bits each. If the packed prefix fits
+// into max_dense_prefix_bits, the suffixes are bucketed by a single counting
+// sort. Otherwise, they are bucketed by the longest prefix that fits, and the
+// buckets are sorted by the remaining characters.
+template<typename buffer_type, typename F,
+    typename index_type, typename value_type>
+auto sort_by_reduced_prefix(value_type const *const text, index_type *const sa,
+                            get_count_type<index_type, buffer_type> const n,
+                            uint8_t prefix) {
+  static_assert(sizeof(value_type) == 1);
+  using count_type = get_count_type<index_type, buffer_type>;
+  using p1_stack_type = phase_1_stack_type<buffer_type>;
+  using p1_group_type = typename p1_stack_type::value_type;
+
+  uint8_t code[256] = {};
+  uint8_t sigma = 0;
+  {
+    count_type histogram[256] = {};
+    for (count_type i = 1; i < n - 1; ++i) {
+      ++histogram[text[i]];
+    }
+    for (uint64_t c = 1; c < 256; ++c) {
+      if (histogram[c] > 0) code[c] = ++sigma;
+    }
+  }
+  uint8_t const bits = 64 - __builtin_clzll(sigma | 1);
+
+  // dense part of the prefix (d characters), remaining part in a 128-bit word
+  uint8_t const d = std::min<uint64_t>(prefix, max_dense_prefix_bits / bits);
+  prefix = std::min<uint64_t>(prefix, d + 128 / bits);
+
+  // code of the character at position j (0 behind the end of the text)
+  auto code_at = [&](uint64_t const j) -> uint64_t {
+      return (j < n) ? code[text[j]] : 0;
+  };
+
+  uint64_t const buckets = 1ULL << (d * bits);
+  uint64_t const mask = buckets - 1;
+  std::vector<count_type> histogram(buckets);
+
+  uint64_t first_key = 0;
+  for (uint64_t j = 1; j <= d; ++j) {
+    first_key = (first_key << bits) | code_at(j);
+  }
+
+  uint64_t key = first_key;
+  for (count_type i = 1; i < n - 1; ++i) {
+    ++histogram[key];
+    key = ((key << bits) | code_at((uint64_t) i + d)) & mask;
+  }
+
+  p1_stack_type result;
+  count_type *const borders = histogram.data();
+  count_type left_border = 2;
+  count_type max_bucket_size = 0;
+  uint64_t used_buckets = 0;
+  for (uint64_t b = 0; b < buckets; ++b) {
+    count_type const gsize = histogram[b];
+    max_bucket_size = std::max(max_bucket_size, gsize);
+    used_buckets += (gsize > 0);
+    borders[b] = left_border;
+    if (gsize > 0 && d == prefix) {
+      result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+    }
+    left_border += gsize;
+  }
+
+  if (used_buckets > scatter_internal::min_scatter_buckets) {
+    blocked_scatter(sa, borders, d * bits, (count_type) 1, n - 1,
+                    [&](count_type const i) {
+                        uint64_t k = 0;
+                        for (uint64_t j = i; j < (uint64_t) i + d; ++j) {
+                          k = (k << bits) | code_at(j);
+                        }
+                        return k;
+                    },
+                    [&](count_type const i) {
+                        return F::conditional_add_flag(text[i - 1] < text[i],
+                                                       (index_type) i);
+                    });
+  } else {
+    key = first_key;
+    for (count_type i = 1; i < n - 1; ++i) {
+      sa[borders[key]++] = F::conditional_add_flag(text[i - 1] < text[i], (index_type) i);
+      key = ((key << bits) | code_at((uint64_t) i + d)) & mask;
+    }
+  }
+
+  if (d < prefix) {
+    // Sort each bucket by the remaining characters. The suffixes in a bucket
+    // are sorted by position, so a stable sort keeps them sorted within the
+    // final groups (which is required by phase 1).
+    auto sort_buckets = [&](auto const tail_of) {
+        using tail_type = decltype(tail_of(0));
+        using pair_type = radix_key_val_pair<tail_type, index_type>;
+        // one additional element to the left for insertion sort
+        pair_type *const memory = (pair_type *) checked_malloc(
+            (((size_t) max_bucket_size << 1) + 1) * sizeof(pair_type));
+        scoped_free const memory_guard(memory);
+        pair_type *const pairs = memory + 1;
+        pair_type *const pairs_buffer = pairs + max_bucket_size;
+
+        count_type left = 2;
+        for (uint64_t b = 0; b < buckets; ++b) {
+          // borders[b] is now the right border of bucket b
+          count_type const gsize = borders[b] - left;
+          index_type *const bucket = &(sa[left]);
+          if (gsize == 1) {
+            result.emplace_back(p1_group_type{left, gsize, 1, true, false});
+          } else if (gsize > 1) {
+            tail_type max_tail = 0;
+            for (count_type i = 0; i < gsize; ++i) {
+              tail_type const tail = tail_of(F::remove_flag(bucket[i]));
+              pairs[i] = pair_type{tail, bucket[i]};
+              max_tail = std::max(max_tail, tail);
+            }
+            if constexpr (sizeof(tail_type) <= sizeof(uint64_t)) {
+              MSD::sort<true, true>(pairs, pairs_buffer, gsize, max_tail);
+            } else {
+              std::stable_sort(pairs, pairs + gsize,
+                               [](pair_type const &x, pair_type const &y) {
+                                   return x.key < y.key;
+                               });
+            }
+
+            count_type start = 0;
+            for (count_type i = 0; i < gsize; ++i) {
+              bucket[i] = pairs[i].value;
+              if (i > 0 && pairs[i].key != pairs[i - 1].key) {
+                result.emplace_back(p1_group_type{left + start, i - start, 1,
+                                                  true, false});
+                start = i;
+              }
+            }
+            result.emplace_back(p1_group_type{left + start, gsize - start, 1,
+                                              true, false});
+          }
+          left = borders[b];
+        }
+    };
+    if ((prefix - d) * bits <= 64) {
+      sort_buckets([&](uint64_t const pos) {
+          uint64_t tail = 0;
+          for (uint64_t j = pos + d; j < pos + prefix; ++j) {
+            tail = (tail << bits) | code_at(j);
+          }
+          return tail;
+      });
+    } else {
+      sort_buckets([&](uint64_t const pos) {
+          uint128_t tail = 0;
+          for (uint64_t j = pos + d; j < pos + prefix; ++j) {
+            tail = (tail << bits) | code_at(j);
+          }
+          return tail;
+      });
+    }
+  }
+
+  sa[0] = n - 1;
+  sa[1] = 0;
+  return result;
+}
+
 template<typename buffer_type, typename F,
     typename index_type, typename value_type>
 auto sort_by_prefix(value_type const *const text, index_type *const sa,
@@ -25,15 +196,26 @@ auto sort_by_prefix(value_type const *const text, index_type *const sa,
   using p1_group_type = typename p1_stack_type::value_type;
 
   p1_stack_type result;
-  if (sizeof(value_type) == 1) {
+  if constexpr (sizeof(value_type) == 1) {
+    if (prefix > 3) {
+      return sort_by_reduced_prefix<buffer_type, F>(text, sa, n, prefix);
+    }
+  }
+  // 16-bit characters are bucketed by a dense counting sort as well (prefix 1
+  // only, longer prefixes use the comparison sort below). Wider characters
+  // always use the comparison sort, their histograms would not fit.
+  if constexpr (sizeof(value_type) <= 2) {
+    if (sizeof(value_type) == 1 || prefix == 1) {
       if (prefix == 1) {
-        count_type histogram[256] = {};
+        constexpr uint64_t sigma =
+            1ULL << (sizeof(value_type) * 8);
+        std::vector<count_type> histogram(sigma);
         for (count_type i = 0; i < n; ++i) {
           ++histogram[text[i]];
         }
-        count_type *const borders = histogram;
+        count_type *const borders = histogram.data();
         count_type left_border = 2;
-        for (count_type b = 1; b < 256; ++b) {
+        for (uint64_t b = 1; b < sigma; ++b) {
           count_type gsize = histogram[b];
           borders[b] = left_border;
           if (gsize > 0) {
@@ -48,7 +230,7 @@ auto sort_by_prefix(value_type const *const text, index_type *const sa,
       } else {
         count_type const buckets = 1ULL << (prefix << 3);
         std::vector<count_type> histogram(buckets);
-        count_type const stop = n - prefix - 1;
+        count_type const stop = (n > (count_type) prefix + 2) ? n - prefix - 1 : 1;
 
         for (count_type i = 1; i < stop; ++i) {
           ++histogram[extract(text, i, prefix)];
@@ -57,9 +239,11 @@ auto sort_by_prefix(value_type const *const text, index_type *const sa,
           ++histogram[safe_extract(text, i, prefix)];
         }
 
+        // keys below buckets >> 8 do not occur (the first character is never
+        // the sentinel), their borders are set for blocked_scatter
         count_type *const borders = histogram.data();
         count_type left_border = 2;
-        for (count_type b = buckets >> 8; b < buckets; ++b) {
+        for (count_type b = 0; b < buckets; ++b) {
           count_type gsize = histogram[b];
           borders[b] = left_border;
           if (gsize > 0) {
@@ -68,45 +252,60 @@ auto sort_by_prefix(value_type const *const text, index_type *const sa,
           left_border += gsize;
         }
 
-    	for (count_type i = 1; i < stop; ++i) {
-      	    sa[borders[extract(text, i, prefix)]++] = F::conditional_add_flag(
-          	text[i - 1] < text[i], i);
-    	}
-    	for (count_type i = stop; i < n - 1; ++i) {
-            sa[borders[safe_extract(text, i, prefix)]++] = F::conditional_add_flag(
-          	text[i - 1] < text[i], i);
-    	}
+        auto const key_of = [&](count_type const i) -> uint64_t {
+            return (i < stop) ? (uint64_t) extract(text, i, prefix)
+                              : (uint64_t) safe_extract(text, i, prefix);
+        };
+        auto const value_of = [&](count_type const i) {
+            return F::conditional_add_flag(text[i - 1] < text[i], (index_type) i);
+        };
+        if (result.size() > scatter_internal::min_scatter_buckets) {
+          blocked_scatter(sa, borders, prefix << 3, (count_type) 1, n - 1,
+                          key_of, value_of);
+        } else {
+          for (count_type i = 1; i < n - 1; ++i) {
+            sa[borders[key_of(i)]++] = value_of(i);
+          }
+        }
       }
+      sa[0] = n - 1;
+      sa[1] = 0;
+      return result;
+    }
   }
-  else {
-      // fill sa with values
-      for (count_type i = 0; i < n; ++i) {
-          sa[i] = i;
-      }
 
-      // sort sa by first character
-      auto comp = [&](auto a, auto b) {
-           auto extracted1 = safe_extract(text, a, prefix);
-           auto extracted2 = safe_extract(text, b, prefix);
-           return (extracted1 < extracted2) || ((extracted1 == extracted2) && a < b);
-      };
-      ips4o::sort(&(sa[0]), &(sa[n]), comp);
-
-      // determine gsizes
-      count_type left_border = 2;
-      count_type gsize = 1;
-      for (count_type i = 2; i < n-1; ++i) {
-          if (safe_extract(text, sa[i], prefix) == safe_extract(text, sa[i+1], prefix)) {
-              ++gsize;
-          }
-          else {
-              result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
-              left_border = i+1;
-              gsize = 1;
-          }
+  // fill sa with values; the sentinel n - 1 is excluded from sorting,
+  // since safe_extract would read behind it
+  sa[0] = n - 1;
+  for (count_type i = 0; i < n - 1; ++i) {
+      sa[i + 1] = i;
+  }
+
+  // sort sa by first character(s), at most 128 bits
+  uint8_t const wide_prefix = std::min<uint64_t>(
+      prefix, sizeof(uint128_t) / sizeof(value_type));
+  auto comp = [&](auto a, auto b) {
+       auto extracted1 = safe_extract(text, a, wide_prefix);
+       auto extracted2 = safe_extract(text, b, wide_prefix);
+       return (extracted1 < extracted2) || ((extracted1 == extracted2) && a < b);
+  };
+  ips4o::sort(&(sa[1]), &(sa[n]), comp);
+
+  // determine gsizes
+  count_type left_border = 2;
+  count_type gsize = 1;
+  for (count_type i = 2; i < n-1; ++i) {
+      if (safe_extract(text, sa[i], wide_prefix) == safe_extract(text, sa[i+1], wide_prefix)) {
+          ++gsize;
+      }
+      else {
+          result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+          left_border = i+1;
+          gsize = 1;
       }
-      result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
   }
+  result.emplace_back(p1_group_type{left_border, gsize, 1, true, false});
+
   sa[0] = n - 1;
   sa[1] = 0;
   return result;
@@ -116,7 +315,7 @@ auto sort_by_prefix(value_type const *const text, index_type *const sa,
 
 template<typename p1_sorter = MSD, typename p2_sorter = MSD,
     typename buffer_type = auto_buffer_type,
-    bool use_flags = true,
+    uint8_t use_flags = flags_bitset,
     typename index_type, // auto deduce
     typename value_type, // auto deduce
     typename used_buffer_type = get_buffer_type <buffer_type, index_type>>
@@ -128,6 +327,17 @@ static void gsaca_ds(value_type const *const text, index_type *const sa,
   static_assert(check_buffer_type<buffer_type, index_type, used_buffer_type>);
   //static_assert(sizeof(value_type) == 1);
 
+  if constexpr (use_flags == flags_bitset) {
+    constexpr uint64_t max_n = max_bitset_flags_n<index_type, used_buffer_type>;
+    if (gsaca_unlikely(n > max_n)) {
+      LOG_VERBOSE << "Text too long for flags in the SA, use bit vector."
+                  << std::endl;
+      gsaca_ds<p1_sorter, p2_sorter, buffer_type, flags_bitvector>(
+          text, sa, n, initial_sort_prefix_len);
+      return;
+    }
+  }
+
   using F = flag_type<use_flags>;
 
   timer time1;
@@ -136,11 +346,13 @@ static void gsaca_ds(value_type const *const text, index_type *const sa,
   time2.begin();
   LOG_VERBOSE << "\n\nStart SACA..." << std::endl;
 
+  F const flags(text, n);
   auto p1_input_groups =
       double_sort_internal::sort_by_prefix<used_buffer_type, F>(
           text, sa, n, initial_sort_prefix_len);
   used_buffer_type *const isa =
-      (used_buffer_type *) malloc(n * sizeof(used_buffer_type));
+      (used_buffer_type *) checked_malloc(n * sizeof(used_buffer_type));
+  scoped_free isa_guard(isa);
 
   time2.end();
   LOG_VERBOSE << "Prepared phase 1: " << time2.throughput_string(n)
@@ -160,8 +372,8 @@ static void gsaca_ds(value_type const *const text, index_type *const sa,
 
   time1.begin();
   phase_2_by_sorting<p2_sorter, F>(sa, isa, n, p2_input_groups.data(),
-                                   p2_input_groups.size());
-  free(isa);
+                                   p2_input_groups.size(), flags);
+  isa_guard.reset();
   time1.end();
 
   LOG_VERBOSE << "Phase 2 (incl. free isa): " << time1.throughput_string(n)
@@ -196,4 +408,18 @@ static void gsaca_ds3(value_type const *const text, index_type *const sa,
   gsaca_ds<p1_sorter, p2_sorter, buffer_type>(text, sa, n, 3);
 }
 
+// Initial grouping by prefixes of length k. For byte alphabets with k > 3,
+// the alphabet is reduced first (see sort_by_reduced_prefix): for DNA, up to
+// 8 characters fit into the dense histogram, longer prefixes and larger
+// alphabets are handled by additionally sorting the buckets.
+template<typename p1_sorter = MSD, typename p2_sorter = MSD,
+    typename buffer_type = auto_buffer_type,
+    typename index_type, // auto deduce
+    typename value_type>
+static void gsaca_dsK(value_type const *const text, index_type *const sa,
+                      size_t const n, size_t const k) {
+  gsaca_ds<p1_sorter, p2_sorter, buffer_type>(text, sa, n,
+                                              std::min((size_t) 255, k));
+}
+
 }
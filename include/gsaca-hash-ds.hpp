@@ -4,6 +4,7 @@
 #include "common/util.hpp"
 #include "sequential/phase_1.hpp"
 #include "common/logging.hpp"
+#include "common/memory.hpp"
 #include "hashing/robin-hood.h"
 #include <algorithm>
 #include <chrono>
@@ -12,9 +13,55 @@
 
 namespace gsaca_lyndon {
 
+namespace hash_ds_internal {
+
+// Lyndon words of up to 64 bits are packed into 64-bit nano texts, longer
+// ones (up to 128 bits) into 128-bit nano texts.
+template<uint64_t bits>
+using nano_type = std::conditional_t<(bits > 64), uint128_t, uint64_t>;
+
+// by default, as many characters as fit into 64 bits (but at least three)
+template<typename value_type>
+constexpr uint64_t default_max_hashing =
+    std::max((size_t) 3, 8 / sizeof(value_type));
+
+template<typename nano_type>
+struct nano_hash : robin_hood::hash<nano_type> {};
+
+template<>
+struct nano_hash<uint128_t> {
+  size_t operator()(uint128_t const x) const noexcept {
+    return robin_hood::hash_int(
+        ((uint64_t) x) ^ robin_hood::hash_int((uint64_t) (x >> 64)));
+  }
+};
+
+// number of trailing zero bits (the nano text must not be 0)
+gsaca_always_inline uint64_t trailing_zero_bits(uint64_t const x) {
+  return __builtin_ctzll(x);
+}
+
+gsaca_always_inline uint64_t trailing_zero_bits(uint128_t const x) {
+  uint64_t const low = (uint64_t) x;
+  return (low != 0) ? __builtin_ctzll(low)
+                    : 64 + __builtin_ctzll((uint64_t) (x >> 64));
+}
+
+} // namespace hash_ds_internal
+
+// max_hashing value that selects hash_ds_internal::default_max_hashing
+constexpr uint8_t auto_max_hashing = 0;
+
+// Lyndon words of up to max_hashing (at least 3) characters are grouped by
+// hashing before phase 1 (the remaining suffixes are grouped by their first
+// max_hashing characters). The characters are packed into nano texts of 64
+// or 128 bits, e.g., up to 16 bytes, 8 16-bit characters or 4 32-bit
+// characters. Lyndon words of one or two characters that fit into 16 bits are
+// looked up in a table instead.
 template<typename p1_sorter = MSD, typename p2_sorter = MSD,
     typename buffer_type = auto_buffer_type,
-    bool use_flags = true,
+    uint8_t use_flags = flags_bitset,
+    uint8_t max_hashing = auto_max_hashing,
     typename index_type, // auto deduce
     typename value_type, // auto deduce
     typename used_buffer_type = get_buffer_type<buffer_type, index_type>>
@@ -27,17 +74,38 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
   //static_assert(sizeof(value_type) == 1);
   static_assert(sizeof(used_buffer_type) >= 4);
 
+  constexpr uint64_t char_bits = sizeof(value_type) * 8;
+  constexpr uint64_t hashing = (max_hashing == auto_max_hashing)
+      ? hash_ds_internal::default_max_hashing<value_type> : max_hashing;
+  static_assert(hashing >= 3 && hashing * char_bits <= 128);
+
+  if constexpr (use_flags == flags_bitset) {
+    constexpr uint64_t max_n = max_bitset_flags_n<index_type, used_buffer_type>;
+    if (gsaca_unlikely(n > max_n)) {
+      LOG_VERBOSE << "Text too long for flags in the SA, use bit vector."
+                  << std::endl;
+      gsaca_hash_ds<p1_sorter, p2_sorter, buffer_type, flags_bitvector,
+          max_hashing>(text, sa, n);
+      return;
+    }
+  }
+
   using count_type = get_count_type<used_buffer_type, index_type>;
-  using unordered_map64 = robin_hood::unordered_flat_map<uint64_t, used_buffer_type>;
+  using nano_type = hash_ds_internal::nano_type<hashing * char_bits>;
+  using unordered_map64 = robin_hood::unordered_flat_map<nano_type,
+      used_buffer_type, hash_ds_internal::nano_hash<nano_type>>;
   using p1_group_type = phase_1_group_type<used_buffer_type>;
   using p1_stack_type = phase_1_stack_type<used_buffer_type>;
   using F = flag_type<use_flags>;
 
-  constexpr count_type MAX_HASHING = 8;
+  constexpr count_type MAX_HASHING = hashing;
+  constexpr uint64_t nano_bytes = sizeof(nano_type);
+  constexpr uint64_t nano_chars = nano_bytes * 8 / char_bits;
 
   LOG_VERBOSE << "\n\nStart SACA..." << std::endl;
   timer quick_time;
   quick_time.begin();
+  F const flags(text, n);
 
 
   auto lce = [&](count_type const i, count_type const j) {
@@ -84,35 +152,56 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
       }
   };
 
-  struct sorted_group {
+  // the sorted nano texts are overwritten by the groups (same size)
+  struct sorted_group_nopad {
+    used_buffer_type border;
+    used_buffer_type size;
+    used_buffer_type lyndon;
+  };
+
+  constexpr int64_t group_pad = nano_bytes + sizeof(used_buffer_type) -
+                                sizeof(sorted_group_nopad);
+  struct sorted_group_pad {
     used_buffer_type border;
     used_buffer_type size;
     used_buffer_type lyndon;
+    uint8_t dummy[std::max((int64_t) 1, group_pad)];
   };
 
+  using sorted_group = typename std::conditional<(group_pad > 0),
+      sorted_group_pad, sorted_group_nopad>::type;
+
   struct nano_text_nopad {
-    uint64_t text;
+    nano_type key;
     used_buffer_type first;
 
     gsaca_always_inline count_type lyndon() const {
-      return 8 - (__builtin_ctzl(text) >> 3);
+      return nano_chars -
+             hash_ds_internal::trailing_zero_bits(key) / char_bits;
     }
   } __attribute((packed));
 
-  constexpr int64_t pad = sizeof(sorted_group) - sizeof(used_buffer_type) - 8;
+  constexpr int64_t pad = sizeof(sorted_group) - sizeof(used_buffer_type) -
+                          nano_bytes;
   struct nano_text_pad {
-    uint64_t text;
+    nano_type key;
     used_buffer_type first;
     uint8_t dummy[std::max((int64_t) 1, pad)] = {};
 
     gsaca_always_inline count_type lyndon() const {
-      return 8 - (__builtin_ctzl(text) >> 3);
+      return nano_chars -
+             hash_ds_internal::trailing_zero_bits(key) / char_bits;
     }
   } __attribute((packed));
 
   using nano_text = typename std::conditional<(pad > 0),
       nano_text_pad, nano_text_nopad>::type;
 
+  // the characters of a Lyndon word are aligned to the left of the nano text
+  auto to_nano = [](nano_type const nano, count_type const length) {
+      return (nano_type) (nano << ((nano_chars - length) * char_bits));
+  };
+
 
   index_type *const nano_id_of = sa;
   static_assert(sizeof(sorted_group) == sizeof(nano_text));
@@ -125,40 +214,52 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
     std::vector<used_buffer_type> first_occ_lookup16(std::pow(2, 16));
     unordered_map64 first_occ_lookup64;
 
+    // Lyndon words of one or two characters (always fit into the table for
+    // byte texts)
+    auto first_occ_short = [&](uint64_t const nano) -> used_buffer_type & {
+        if constexpr (char_bits == 8) {
+          return first_occ_lookup16[nano];
+        } else {
+          if (nano < (1ULL << 16)) return first_occ_lookup16[nano];
+          return first_occ_lookup64[nano];
+        }
+    };
+
 
     for (count_type i = 1; i < n - 1; ++i) {
       count_type const lyndon_i = smart_lyndon(i);
       if (gsaca_likely(repetitions_i < 3)) {
         // not a run, proceed normally
         if (lyndon_i == 1) {
-          used_buffer_type &first = first_occ_lookup16[text[i]];
+          used_buffer_type &first = first_occ_short(text[i]);
           if (gsaca_unlikely(first == 0)) {
             first = i;
-            to_sort_nano.emplace_back(nano_text{((uint64_t) text[i]) << 56, i});
+            to_sort_nano.emplace_back(nano_text{to_nano(text[i], 1), i});
           } else {
             nano_id_of[i] = first;
           }
         } else if (lyndon_i == 2) {
-          uint64_t const nano = ((uint64_t) text[i]) << 8 | text[i + 1];
-          used_buffer_type &first = first_occ_lookup16[nano];
+          uint64_t const nano =
+              ((uint64_t) text[i]) << char_bits | text[i + 1];
+          used_buffer_type &first = first_occ_short(nano);
           if (gsaca_unlikely(first == 0)) {
             first = i;
-            to_sort_nano.emplace_back(nano_text{nano << 48, i});
+            to_sort_nano.emplace_back(nano_text{to_nano(nano, 2), i});
           } else {
             nano_id_of[i] = first;
             nano_id_of[++i] = first + 1;
           }
         } else {
           auto const lyn = std::min(lyndon_i, MAX_HASHING);
-          uint64_t nano = text[i];
+          nano_type nano = text[i];
           for (count_type j = 1; j < lyn; ++j) {
-            nano <<= 8;
+            nano <<= char_bits;
             nano |= text[i + j];
           }
           used_buffer_type &first = first_occ_lookup64[nano];
           if (gsaca_unlikely(first == 0)) {
             first = i;
-            to_sort_nano.emplace_back(nano_text{nano << ((8 - lyn) << 3), i});
+            to_sort_nano.emplace_back(nano_text{to_nano(nano, lyn), i});
           } else {
             nano_id_of[i] = first;
             if (lyn < MAX_HASHING) {
@@ -170,15 +271,15 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
           }
         }
       } else {
-        uint64_t nano = text[i];
+        nano_type nano = text[i];
         for (count_type j = 1; j < MAX_HASHING; ++j) {
-          nano <<= 8;
+          nano <<= char_bits;
           nano |= text[i + j];
         }
         used_buffer_type &first = first_occ_lookup64[nano];
         if (gsaca_unlikely(first == 0)) {
           first = i;
-          to_sort_nano.emplace_back(nano_text{nano, i});
+          to_sort_nano.emplace_back(nano_text{to_nano(nano, MAX_HASHING), i});
         } else {
           nano_id_of[i] = first;
         }
@@ -189,34 +290,34 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
         for (++i; i < stop; ++i) {
           auto const lyn = naive_lyndon(i);
           if (lyn == 1) {
-            used_buffer_type &first = first_occ_lookup16[text[i]];
+            used_buffer_type &first = first_occ_short(text[i]);
             if (gsaca_unlikely(first == 0)) {
               first = i;
-              to_sort_nano.emplace_back(
-                  nano_text{((uint64_t) text[i]) << 56, i});
+              to_sort_nano.emplace_back(nano_text{to_nano(text[i], 1), i});
             } else {
               nano_id_of[i] = first;
             }
           } else if (lyn == 2) {
-            uint64_t const nano = ((uint64_t) text[i]) << 8 | text[i + 1];
-            used_buffer_type &first = first_occ_lookup16[nano];
+            uint64_t const nano =
+                ((uint64_t) text[i]) << char_bits | text[i + 1];
+            used_buffer_type &first = first_occ_short(nano);
             if (gsaca_unlikely(first == 0)) {
               first = i;
-              to_sort_nano.emplace_back(nano_text{nano << 48, i});
+              to_sort_nano.emplace_back(nano_text{to_nano(nano, 2), i});
             } else {
               nano_id_of[i] = first;
               nano_id_of[++i] = first + 1;
             }
           } else {
-            uint64_t nano = text[i];
+            nano_type nano = text[i];
             for (count_type j = 1; j < lyn; ++j) {
-              nano <<= 8;
+              nano <<= char_bits;
               nano |= text[i + j];
             }
             used_buffer_type &first = first_occ_lookup64[nano];
             if (gsaca_unlikely(first == 0)) {
               first = i;
-              to_sort_nano.emplace_back(nano_text{nano << ((8 - lyn) << 3), i});
+              to_sort_nano.emplace_back(nano_text{to_nano(nano, lyn), i});
             } else {
               nano_id_of[i] = first;
               for (count_type j = 1; j < lyn; ++j) {
@@ -227,9 +328,11 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
           }
         }
 
-        // now we have i = original i + period
-        count_type const last_copy =
-            i + (repetitions - 2) * period - MAX_HASHING;
+        // now we have i = original i + period (short runs at the beginning
+        // of the text have nothing to copy)
+        count_type const copy_length = (repetitions - 2) * period;
+        count_type const last_copy = (copy_length > MAX_HASHING)
+                                     ? i + copy_length - MAX_HASHING : i;
 
         for (; i < last_copy; ++i) {
           nano_id_of[i] = i - period;
@@ -251,10 +354,17 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
   quick_time.begin();
 
   count_type const initial_group_count = to_sort_nano.size();
-  std::sort(to_sort_nano.begin(), to_sort_nano.end(),
-            [](nano_text const &a, nano_text const &b) {
-                return a.text < b.text;
-            });
+  {
+    // the nano texts are distinct, and the first two (the sentinel groups)
+    // are the smallest; MSD radix sort the others (the insertion sort uses
+    // the position in front of the data)
+    count_type const to_sort = initial_group_count - 2;
+    nano_text *const buffer =
+        (nano_text *) checked_malloc((to_sort + 1) * sizeof(nano_text));
+    radix_internal::msd_radix_internal<true>(&(to_sort_nano[2]), buffer + 1,
+                                             to_sort, (uint8_t) nano_bytes);
+    free(buffer);
+  }
   quick_time.end();
   LOG_VERBOSE << "Sorted first occurrences " << quick_time.throughput_string(n)
               << std::endl;
@@ -262,13 +372,17 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
 
 
   quick_time.begin();
+  used_buffer_type *const isa = (used_buffer_type *) checked_malloc(
+      n * sizeof(used_buffer_type));
+  scoped_free isa_guard(isa);
+
+  // first occurrences get their group id in the ISA and reference themselves
+  // (group ids and positions may overlap, e.g., for 32-bit SAs of texts longer
+  // than 2 GiB)
   for (count_type g = 2; g < initial_group_count; ++g) {
-    nano_id_of[to_sort_nano[g].first] = -g;
-  }
-  for (count_type i = 1; i < n - 1; ++i) {
-    nano_id_of[i] = (gsaca_likely(nano_id_of[i] < n))
-                    ? nano_id_of[nano_id_of[i]]
-                    : ((index_type) -nano_id_of[i]);
+    count_type const first = to_sort_nano[g].first;
+    nano_id_of[first] = first;
+    isa[first] = g;
   }
 
   sorted_group *const sorted_groups = (sorted_group *) to_sort_nano.data();
@@ -278,8 +392,13 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
     sorted_groups[g].size = 0;
   }
 
+  // resolve the group ids into the ISA (all other references point to smaller
+  // positions, which are already resolved)
   for (count_type i = 1; i < n - 1; ++i) {
-    ++(sorted_groups[nano_id_of[i]].size);
+    if (gsaca_likely(nano_id_of[i] != i)) isa[i] = isa[nano_id_of[i]];
+  }
+  for (count_type i = 1; i < n - 1; ++i) {
+    ++(sorted_groups[isa[i]].size);
   }
 
   count_type border = 2;
@@ -289,23 +408,20 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
   }
   LOG_VERBOSE << sanity_string(border, n) << std::endl;
 
-  used_buffer_type *const isa = (used_buffer_type *) malloc(
-      n * sizeof(used_buffer_type));
-
-  // sort the SA
-  for (count_type j = 1; j < n - 1; ++j) {
-    isa[j] = nano_id_of[j];
-  }
-  for (count_type j = 1; j < n - 1; ++j) {
-    isa[j] = sorted_groups[isa[j]].border++;
-  }
-  // add flags now, while still sequential text access
+  // sort the SA (add flags now, while still sequential text access)
   for (count_type j = 1; j < n - 1; ++j) {
-    isa[j] = F::conditional_add_flag(text[j - 1] < text[j], isa[j]);
+    isa[j] = F::conditional_add_flag(text[j - 1] < text[j],
+                                     sorted_groups[isa[j]].border++);
   }
   for (count_type j = 1; j < n - 1; ++j) {
-    sa[F::remove_flag(isa[j])] = F::conditional_add_flag(F::is_flagged(isa[j]),
-                                                         j);
+    if constexpr (use_flags == flags_bitset) {
+      // move the flag of the ISA entry to the SA entry
+      sa[F::remove_flag(isa[j])] =
+          F::conditional_add_flag(F::is_flagged(isa[j]), (index_type) j);
+    } else {
+      // no flags in the entries (the bit vector is indexed by text position)
+      sa[isa[j]] = (index_type) j;
+    }
   }
   sa[0] = n - 1;
   sa[1] = 0;
@@ -356,8 +472,9 @@ static void gsaca_hash_ds(value_type const *const text, index_type *const sa,
 
   quick_time.begin();
   phase_2_by_sorting<p2_sorter, F>(sa, isa, n, p2_input_groups.data(),
-                                   (index_type) p2_input_groups.size());
-  free(isa);
+                                   (index_type) p2_input_groups.size(),
+                                   flags);
+  isa_guard.reset();
   quick_time.end();
 
   LOG_VERBOSE << "Phase 2 (incl. free isa): " << quick_time.throughput_string(n)
@@ -0,0 +1,60 @@
+#ifndef _GSACA_LYNDON_H
+#define _GSACA_LYNDON_H 1
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Precompiled entry points of libgsaca_lyndon (see gsaca-lyndon.hpp for the
+ * header-only C++ interface).
+ *
+ * Each function constructs the suffix array of the text T[0, n). Like all
+ * algorithms of this library, it requires sentinels: T[0] and T[n - 1] must
+ * be the unique smallest characters (e.g., 0). Apart from the sentinels, the
+ * text must not contain these characters. The algorithm is chosen
+ * automatically (as in gsaca_lyndon::build_sa).
+ *
+ * Suffix arrays with 40-bit entries are stored in 5 bytes per entry: the
+ * lower 32 bits (in native byte order), followed by the upper 8 bits.
+ *
+ * The _par variants use the given number of threads (0 = all available
+ * threads).
+ *
+ * All functions return 0 if the construction worked, -2 if not enough memory
+ * is available, or -1 otherwise (illegal parameters, e.g., a text that is too
+ * long for the suffix array type).
+ *
+ * The library uses OpenMP and libatomic. When linking the static library,
+ * add them explicitly (e.g., -lgsaca_lyndon -fopenmp -latomic -lstdc++ -lm).
+ */
+
+/* libgsaca_lyndon is built with hidden visibility, only these are exported */
+#define GSACA_LYNDON_API __attribute__((visibility("default")))
+
+#define GSACA_LYNDON_DECLARE(text_name, text_type, sa_name, sa_type)          \
+  GSACA_LYNDON_API int gsaca_lyndon_##text_name##_##sa_name(                   \
+      const text_type *T, sa_type *SA, uint64_t n);                            \
+  GSACA_LYNDON_API int gsaca_lyndon_##text_name##_##sa_name##_par(             \
+      const text_type *T, sa_type *SA, uint64_t n, unsigned int threads);
+
+GSACA_LYNDON_DECLARE(u8, uint8_t, u32, uint32_t)
+GSACA_LYNDON_DECLARE(u8, uint8_t, u40, uint8_t)
+GSACA_LYNDON_DECLARE(u8, uint8_t, u64, uint64_t)
+GSACA_LYNDON_DECLARE(u16, uint16_t, u32, uint32_t)
+GSACA_LYNDON_DECLARE(u16, uint16_t, u40, uint8_t)
+GSACA_LYNDON_DECLARE(u16, uint16_t, u64, uint64_t)
+GSACA_LYNDON_DECLARE(u32, uint32_t, u32, uint32_t)
+GSACA_LYNDON_DECLARE(u32, uint32_t, u40, uint8_t)
+GSACA_LYNDON_DECLARE(u32, uint32_t, u64, uint64_t)
+
+#undef GSACA_LYNDON_DECLARE
+#undef GSACA_LYNDON_API
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif /* __cplusplus */
+
+#endif /* _GSACA_LYNDON_H */
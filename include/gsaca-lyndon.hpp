@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "common/alphabet.hpp"
+#include "gsaca-double-sort.hpp"
+#include "gsaca-double-sort-par.hpp"
+#include "gsaca-double-sort-reduced.hpp"
+#include "gsaca-hash-ds.hpp"
+
+namespace gsaca_lyndon {
+
+struct build_options {
+  // number of threads (0 = all available threads)
+  size_t threads = 1;
+  // number of text positions that are sampled to choose the algorithm
+  size_t sample_size = 1ULL << 14;
+  // print the chosen configuration to std::cout
+  bool report = false;
+  // map wide characters to their ranks in the narrowest type that fits the
+  // alphabet (see with_compact_alphabet), which costs one copy of the text
+  bool compact_alphabet = true;
+};
+
+// properties of the text, estimated from a sample
+struct text_stats {
+  // number of distinct characters in the sample
+  uint64_t sigma = 0;
+  // empirical (zeroth order) entropy of the sample in bits
+  double entropy = 0;
+  // average length of the longest Lyndon word starting at a sampled position
+  // (at most build_internal::lyndon_cap)
+  double lyndon_avg = 0;
+  // share of the sampled positions that start a run of at least three periods
+  double run_share = 0;
+};
+
+enum class build_algorithm {
+  gsaca_ds, gsaca_ds_par, gsaca_hash_ds, gsaca_ds_reduced
+};
+
+// the configuration chosen by build_sa
+struct build_config {
+  build_algorithm algorithm = build_algorithm::gsaca_ds;
+  size_t prefix = 1;
+  size_t threads = 1;
+  // width of the ISA and phase buffers (the SA has the width of index_type)
+  size_t buffer_bits = 32;
+  // width of the characters that are sorted (less than the width of the input
+  // if the alphabet was compacted)
+  size_t value_bits = 8;
+  text_stats stats;
+
+  std::string algorithm_name() const {
+    switch (algorithm) {
+      case build_algorithm::gsaca_ds:
+        return "gsaca_ds" + std::to_string(prefix);
+      case build_algorithm::gsaca_ds_par:
+        return "gsaca_ds" + std::to_string(prefix) + "_par";
+      case build_algorithm::gsaca_ds_reduced:
+        return "gsaca_ds_reduced";
+      default:
+        return "gsaca_hash_ds";
+    }
+  }
+
+  std::string to_string() const {
+    std::stringstream ss;
+    ss << "algo=" << algorithm_name()
+       << " threads=" << threads
+       << " buffer_bits=" << buffer_bits
+       << " value_bits=" << value_bits
+       << " sigma=" << stats.sigma
+       << " entropy=" << stats.entropy
+       << " lyndon_avg=" << stats.lyndon_avg
+       << " run_share=" << stats.run_share;
+    return ss.str();
+  }
+};
+
+namespace build_internal {
+
+// the Lyndon words of sampled positions are computed up to this length
+constexpr size_t lyndon_cap = 64;
+// smaller texts are always handled sequentially
+constexpr size_t min_parallel_n = 1ULL << 20;
+// smaller byte texts use initial buckets of one character
+constexpr size_t min_ds2_n = 1ULL << 16;
+// gsaca_hash_ds is the fastest choice for small alphabets (e.g., DNA) without
+// long Lyndon words, unless the text is highly repetitive
+constexpr uint64_t hash_max_sigma = 4;
+constexpr double hash_max_lyndon_avg = 8.0;
+constexpr double max_run_share = 0.5;
+// byte texts with long Lyndon words are sorted via the reduced text (phase 1
+// would refine the initial groups many times)
+constexpr double reduced_min_lyndon_avg = 16.0;
+
+template<typename value_type>
+text_stats sample(value_type const *const text, size_t const n,
+                  size_t const sample_size) {
+  text_stats result;
+  if (n < 3) return result;
+
+  size_t const step = std::max((size_t) 1, (n - 2) / std::max(
+      sample_size, (size_t) 1));
+  std::vector<value_type> chars;
+  size_t lyndon_sum = 0;
+  size_t runs = 0;
+  for (size_t i = 1; i < n - 1; i += step) {
+    chars.push_back(text[i]);
+
+    // longest Lyndon word starting at i (same as naive_lyndon in
+    // gsaca_hash_ds, but capped); j - k is the period of text[i, j)
+    size_t const end = std::min(n - 1, i + lyndon_cap);
+    size_t j = i + 1;
+    size_t k = i;
+    while (j < end && text[k] <= text[j]) {
+      k = (text[k] < text[j]) ? i : k + 1;
+      ++j;
+    }
+    lyndon_sum += j - k;
+    runs += (j == end && k != i && (j - i) >= 3 * (j - k));
+  }
+
+  size_t const samples = chars.size();
+  std::sort(chars.begin(), chars.end());
+  for (size_t l = 0; l < samples;) {
+    size_t r = l;
+    while (r < samples && chars[r] == chars[l]) ++r;
+    double const p = (double) (r - l) / samples;
+    result.entropy -= p * std::log2(p);
+    ++result.sigma;
+    l = r;
+  }
+  result.lyndon_avg = (double) lyndon_sum / samples;
+  result.run_share = (double) runs / samples;
+  return result;
+}
+
+template<typename index_type, typename value_type>
+build_config choose(text_stats const &stats, size_t const n,
+                    size_t const threads) {
+  build_config result;
+  result.stats = stats;
+  result.threads = (n >= min_parallel_n) ? threads : 1;
+  // one-character buckets are best for wide characters and short texts
+  result.prefix = (sizeof(value_type) == 1 && n >= min_ds2_n) ? 2 : 1;
+
+  if (result.threads > 1) {
+    result.algorithm = build_algorithm::gsaca_ds_par;
+  } else if (sizeof(value_type) == 1 &&
+             stats.lyndon_avg >= reduced_min_lyndon_avg) {
+    result.algorithm = build_algorithm::gsaca_ds_reduced;
+  } else if (sizeof(value_type) == 1 && sizeof(index_type) >= 4 &&
+             stats.sigma <= hash_max_sigma &&
+             stats.lyndon_avg <= hash_max_lyndon_avg &&
+             stats.run_share < max_run_share) {
+    result.algorithm = build_algorithm::gsaca_hash_ds;
+  } else {
+    result.algorithm = build_algorithm::gsaca_ds;
+  }
+  return result;
+}
+
+template<typename buffer_type, typename index_type, typename value_type>
+void run(build_config const &config, value_type const *const text,
+         index_type *const sa, size_t const n) {
+  switch (config.algorithm) {
+    case build_algorithm::gsaca_ds_par:
+      gsaca_ds_par<buffer_type>(text, sa, n, config.threads, config.prefix);
+      break;
+    case build_algorithm::gsaca_ds_reduced:
+      if constexpr (sizeof(value_type) == 1) {
+        gsaca_ds_reduced<MSD, MSD>(text, sa, n);
+        break;
+      }
+      [[fallthrough]];
+    case build_algorithm::gsaca_hash_ds:
+      if constexpr (sizeof(value_type) == 1 && sizeof(index_type) >= 4) {
+        gsaca_hash_ds<MSD, MSD, buffer_type>(text, sa, n);
+        break;
+      }
+      [[fallthrough]];
+    default:
+      gsaca_ds<MSD, MSD, buffer_type>(text, sa, n, config.prefix);
+  }
+}
+
+template<typename index_type, typename value_type>
+build_config build(value_type const *const text, index_type *const sa,
+                   size_t const n, size_t const threads,
+                   build_options const &options) {
+  text_stats const stats = sample(text, n, options.sample_size);
+  build_config config = choose<index_type, value_type>(stats, n, threads);
+  config.value_bits = sizeof(value_type) * 8;
+
+  // 64-bit indices use the narrowest buffer that fits the text
+  if constexpr (sizeof(index_type) > 6) {
+    if (n <= (1ULL << 40)) {
+      config.buffer_bits = 40;
+    } else if (n <= (1ULL << 48)) {
+      config.buffer_bits = 48;
+    } else {
+      config.buffer_bits = 64;
+    }
+  } else {
+    config.buffer_bits = sizeof(index_type) * 8;
+  }
+
+  if (options.report) {
+    std::cout << "build_sa: " << config.to_string() << std::endl;
+  }
+  LOG_VERBOSE << "build_sa: " << config.to_string() << std::endl;
+
+  if constexpr (sizeof(index_type) > 6) {
+    if (config.buffer_bits == 40) {
+      run<uint40_t>(config, text, sa, n);
+    } else if (config.buffer_bits == 48) {
+      run<uint48_t>(config, text, sa, n);
+    } else {
+      run<index_type>(config, text, sa, n);
+    }
+  } else {
+    run<auto_buffer_type>(config, text, sa, n);
+  }
+  return config;
+}
+
+} // namespace build_internal
+
+// Computes the suffix array of text[0, n), where text[0] and text[n - 1] are
+// sentinels (like all other SACAs of this library). Wide characters are
+// compacted to the narrowest type that fits the alphabet first. The algorithm,
+// the initial prefix length and the buffer width are chosen based on a sample
+// of the text; the returned configuration can be used for logging.
+template<typename index_type, typename value_type>
+build_config build_sa(value_type const *const text, index_type *const sa,
+                      size_t const n, build_options const &options = {}) {
+  static_assert(std::is_unsigned<value_type>::value);
+  static_assert(std::is_unsigned<index_type>::value);
+
+  if (n > (uint64_t) std::numeric_limits<index_type>::max()) {
+    throw std::length_error(
+        "gsaca_lyndon::build_sa: text too long for the index type");
+  }
+
+  size_t const threads = (options.threads == 0)
+                         ? (size_t) omp_get_max_threads() : options.threads;
+  // only sentinels
+  if (gsaca_unlikely(n < 3)) {
+    for (size_t i = 0; i < n; ++i) sa[i] = n - 1 - i;
+    return build_config{};
+  }
+  if (options.compact_alphabet) {
+    return with_compact_alphabet(text, n, [&](auto const *const compact) {
+        return build_internal::build(compact, sa, n, threads, options);
+    }, threads);
+  }
+  return build_internal::build(text, sa, n, threads, options);
+}
+
+} // namespace gsaca_lyndon
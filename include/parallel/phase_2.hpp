@@ -2,32 +2,37 @@
 
 #include "common/logging.hpp"
 #include "common/timer.hpp"
+#include "common/memory.hpp"
 #include "common/phase_types.hpp"
+#include "common/runs.hpp"
 #include <ips4o/ips4o.hpp>
 
 #include <sorting/radix32.hpp>
+#include <sorting/network.hpp>
 
 namespace gsaca_lyndon {
 
 const size_t seq_threshold = 1025;
 
 template<typename F = flag_type<false>, typename index_type, typename buffer_type>
-inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type *const isa, size_t const n,
+inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type *const isa, size_t const,
                                phase_2_group_type<buffer_type> const *const groups,
-                               size_t const number_of_groups, size_t threads) {
+                               size_t const number_of_groups, size_t threads,
+                               F const &flags) {
   using count_type = get_count_type<index_type, buffer_type>;
   using key_value_pair = radix_key_val_pair<buffer_type>;
 
-  count_type max_group_size = 0;
-  #pragma omp parallel for reduction(max:max_group_size)
-  for (count_type g = 0; g < number_of_groups; ++g) {
-    max_group_size = std::max(max_group_size, (count_type) groups[g].size);
-  }
+  std::vector<size_t> chain_groups;
+  size_t next_chain = 0;
+  count_type const max_group_size =
+      max_non_chain_group_size<F>(sa, groups, number_of_groups, chain_groups,
+                                  threads);
 
   constexpr count_type sg_count_threshold = 256ULL * 1024; // 1MiB buffer
-  void *memory = malloc(
+  void *memory = checked_malloc(
       sg_count_threshold * sizeof(count_type) +
-      ((max_group_size + 1) << 1) * sizeof(key_value_pair));
+      (((size_t) max_group_size + 1) << 1) * sizeof(key_value_pair));
+  scoped_free const memory_guard(memory);
 
   count_type *const subgroup_border_buffer = (count_type *) memory;
   key_value_pair *grouped_indices = (key_value_pair *) (subgroup_border_buffer +
@@ -49,6 +54,13 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
       isa[sa[left_border]] = left_border;
       ++left_border;
     }
+    else if ((gsize < runs_internal::chain_check_min)
+             ? is_single_chain<F>(&(sa[left_border]), gsize, groups[g].lyndon)
+             : is_next_chain(chain_groups, next_chain, g)) {
+      phase_2_resolve_chain<F>(&(sa[left_border]), isa, left_border, gsize,
+                               flags, threads);
+      left_border += gsize;
+    }
     else if (gsize < seq_threshold) {
       count_type const lyn = groups[g].lyndon;
       index_type *const sa_interval = &(sa[left_border]);
@@ -73,7 +85,7 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
       count_type *const subgroup_border =
           (gsaca_likely(sg_count < sg_count_threshold))
           ? (subgroup_border_buffer)
-          : ((count_type *) malloc(sg_count * sizeof(count_type)));
+          : ((count_type *) checked_malloc(sg_count * sizeof(count_type)));
 
 
       count_type local_left_border = 0;
@@ -84,7 +96,8 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
 
       for (count_type i = 0; i < gsize; ++i) {
         count_type &border = subgroup_border[subgroup_id[i]];
-        grouped_indices[border++].value = sa_interval[i];
+        grouped_indices[border++].value =
+            convert_flagged<F, buffer_type>(sa_interval[i]);
       }
 
       count_type previous_border = 0;
@@ -92,25 +105,33 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
         count_type const stop = subgroup_border[j];
 
         // retrieve lexicographical rank of inducers
+        uint64_t min_key = std::numeric_limits<uint64_t>::max();
+        uint64_t max_key = 0;
         for (count_type i = previous_border; i < stop; ++i) {
-          grouped_indices[i].key = isa[
+          buffer_type const key = isa[
               F::remove_flag(grouped_indices[i].value) + lyn];
+          grouped_indices[i].key = key;
+          min_key = std::min(min_key, (uint64_t) key);
+          max_key = std::max(max_key, (uint64_t) key);
         }
 
         if (gsaca_likely(stop - previous_border < 33)) {
-          radix_internal::insertion<true>(
-              &(grouped_indices[previous_border]), stop - previous_border);
+          small_sort<true>(&(grouped_indices[previous_border]),
+                           stop - previous_border, max_key);
         } else {
+            compress_keys(&(grouped_indices[previous_border]),
+                          stop - previous_border, min_key, max_key);
             gsaca_lyndon::msd_radix(&(grouped_indices[previous_border]),
                                   grouped_indices_buffer,
-                                  stop - previous_border, n - 1);
+                                  stop - previous_border, max_key);
         }
 
         for (count_type i = previous_border; i < stop; ++i) {
-          sa_interval[i] = grouped_indices[i].value;
+          sa_interval[i] =
+              convert_flagged<F, index_type>(grouped_indices[i].value);
         }
         for (count_type i = previous_border; i < stop; ++i) {
-          if (!F::is_flagged(sa_interval[i])) {
+          if (!flags.is_flagged(sa_interval[i])) {
             isa[sa_interval[i]] = left_border + i;
           } else {
             sa_interval[i] = F::remove_flag(sa_interval[i]);
@@ -166,7 +187,7 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
       count_type *const subgroup_border =
           (gsaca_likely(threads*sg_count < sg_count_threshold))
           ? (subgroup_border_buffer)
-          : ((count_type *) malloc(threads*sg_count * sizeof(count_type)));
+          : ((count_type *) checked_malloc(threads*sg_count * sizeof(count_type)));
 
       for (count_type i = 0; i < threads*sg_count; ++i)
           subgroup_border[i] = 0;
@@ -203,7 +224,8 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
 
           for (count_type j = interval_begin; j < interval_end; ++j) {
               count_type &border = subgroup_border_thread[subgroup_id[j]];
-              grouped_indices[border++] = {0, sa_interval[j]};
+              grouped_indices[border++] =
+                  {0, convert_flagged<F, buffer_type>(sa_interval[j])};
           }
       }
 
@@ -223,11 +245,12 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
 
         #pragma omp parallel for
         for (count_type i = previous_border; i < stop; ++i) {
-          sa_interval[i] = grouped_indices[i].value;
+          sa_interval[i] =
+              convert_flagged<F, index_type>(grouped_indices[i].value);
         }
         #pragma omp parallel for
         for (count_type i = previous_border; i < stop; ++i) {
-            if (!F::is_flagged(sa_interval[i])) {
+            if (!flags.is_flagged(sa_interval[i])) {
               isa[sa_interval[i]] = left_border + i;
             } else {
               sa_interval[i] = F::remove_flag(sa_interval[i]);
@@ -236,7 +259,7 @@ inline void phase_2_by_sorting_stable_parallel(index_type *const sa, buffer_type
         previous_border = stop;
       }
 
-      if (gsaca_unlikely(sg_count >= sg_count_threshold)) {
+      if (gsaca_unlikely(threads*sg_count >= sg_count_threshold)) {
         free(subgroup_border);
       }
 
@@ -8,7 +8,9 @@
 #include <stdlib.h>
 #include "phase_2.hpp"
 #include "sorting/radix32.hpp"
+#include "common/memory.hpp"
 #include "common/phase_types.hpp"
+#include "common/runs.hpp"
 
 
 namespace gsaca_lyndon {
@@ -22,10 +24,12 @@ inline auto phase_1_by_sorting(index_type *const sa, buffer_type *const isa,
   using input_type = phase_1_group_type<buffer_type>;
   using sorting_type = radix_key_val_pair<buffer_type>;
 
-  size_t max_group_size = 0;
-  for (auto const &group : input_groups) {
-    max_group_size = std::max(max_group_size, (size_t) group.size);
-  }
+  std::vector<size_t> chain_groups;
+  size_t next_chain = 0;
+  size_t const max_group_size =
+      max_non_chain_group_size<F>(sa, input_groups, chain_groups);
+  // the input groups below this index have not been taken from the stack yet
+  size_t initial_groups = input_groups.size();
 
   count_type const n = input_groups.back().start + input_groups.back().size;
 
@@ -35,13 +39,18 @@ inline auto phase_1_by_sorting(index_type *const sa, buffer_type *const isa,
 
   std::vector<output_type> result_groups(1);
 
-  // twice the size for out-of-place radix sort
-  sorting_type *to_sort = (sorting_type *) malloc(
-      (max_group_size) * sizeof(sorting_type) * 2);
+  // twice the size for out-of-place radix sort, and one entry to the left
+  // (insertion sort uses it as sentinel)
+  sorting_type *const to_sort_memory = (sorting_type *) checked_malloc(
+      (max_group_size * 2 + 1) * sizeof(sorting_type));
+  scoped_free const to_sort_guard(to_sort_memory);
+  sorting_type *const to_sort = to_sort_memory + 1;
 
   buffer_type *const subgroup_id = (buffer_type *) to_sort;
 
   while (!input_groups.empty()) {
+    bool const is_input_group = (input_groups.size() == initial_groups);
+    initial_groups -= is_input_group;
     auto const group = input_groups.back();
     input_groups.pop_back();
 
@@ -70,25 +79,35 @@ inline auto phase_1_by_sorting(index_type *const sa, buffer_type *const isa,
       } else {
         // let's sort the group by the rank behind the context
         for (count_type i = 0; i < gsize; ++i) {
-          to_sort[i].value = sa_interval[i];
+          to_sort[i].value =
+              convert_flagged<F, buffer_type>(sa_interval[i]);
         }
+        uint64_t min_rank = std::numeric_limits<uint64_t>::max();
+        uint64_t max_rank = 0;
         for (count_type i = 0; i < gsize; ++i) {
-          to_sort[i].key = rank[F::remove_flag(to_sort[i].value) + gcontext];
+          buffer_type const key =
+              rank[F::remove_flag(to_sort[i].value) + gcontext];
+          to_sort[i].key = key;
+          min_rank = std::min(min_rank, (uint64_t) key);
+          max_rank = std::max(max_rank, (uint64_t) key);
         }
 
-        size_t max_rank = result_groups.size() - 1;
+        // the offset has to be added to the keys when accessing the groups
+        uint64_t const rank_offset =
+            compress_keys(to_sort, gsize, min_rank, max_rank);
         // decreasing sort, stable sort
         sorter::template sort<false, true>(to_sort, to_sort + gsize, gsize,
                                            max_rank);
 
         for (count_type i = 0; i < gsize; ++i) {
-          sa_interval[i] = to_sort[i].value;
+          sa_interval[i] = convert_flagged<F, index_type>(to_sort[i].value);
         }
 
         count_type sg_size = 1;
         buffer_type sg_start = 0;
         buffer_type sg_key = to_sort[0].key;
-        buffer_type sg_context = gcontext + result_groups[sg_key].lyndon;
+        buffer_type sg_context =
+            gcontext + result_groups[sg_key + rank_offset].lyndon;
         for (count_type i = 1; i < gsize; ++i) {
           if (to_sort[i].key == sg_key) {
             ++sg_size;
@@ -101,12 +120,18 @@ inline auto phase_1_by_sorting(index_type *const sa, buffer_type *const isa,
             sg_start = i;
             sg_size = 1;
             sg_key = to_sort[i].key;
-            sg_context = gcontext + result_groups[sg_key].lyndon;
+            sg_context = gcontext + result_groups[sg_key + rank_offset].lyndon;
           }
         }
         input_groups.emplace_back(
             input_type{gstart + sg_start, sg_size, sg_context, true, false});
       }
+    } else if ((is_input_group && gsize >= runs_internal::chain_check_min)
+               ? is_next_chain(chain_groups, next_chain, initial_groups)
+               : is_single_chain<F>(sa_interval, gsize, gcontext)) {
+      phase_1_resolve_chain<F, count_type>(sa_interval, rank, gstart, gsize,
+                                           gcontext, result_groups,
+                                           input_groups);
     } else {
       buffer_type *const subgroup_size = subgroup_id + gsize;
       memset(subgroup_size, 0, (gsize + 2) * sizeof(buffer_type));
@@ -150,10 +175,11 @@ inline auto phase_1_by_sorting(index_type *const sa, buffer_type *const isa,
         subgroup_id[i] = subgroup_size[subgroup_id[i]]++;
       }
       for (count_type i = 0; i < gsize; ++i) {
-        subgroup_size[subgroup_id[i]] = sa_interval[i];
+        subgroup_size[subgroup_id[i]] =
+            convert_flagged<F, buffer_type>(sa_interval[i]);
       }
       for (count_type i = 0; i < gsize; ++i) {
-        sa_interval[i] = subgroup_size[i];
+        sa_interval[i] = convert_flagged<F, index_type>(subgroup_size[i]);
       }
 
     }
@@ -164,7 +190,6 @@ inline auto phase_1_by_sorting(index_type *const sa, buffer_type *const isa,
   sa[1] = 0;
   std::reverse(result_groups.begin(), result_groups.end());
   result_groups.resize(result_groups.size() - 1);
-  free(to_sort);
   return result_groups;
 }
 
@@ -2,10 +2,14 @@
 
 #include "common/logging.hpp"
 #include "common/timer.hpp"
+#include "common/memory.hpp"
 #include "common/phase_types.hpp"
+#include "common/runs.hpp"
 #include <ips4o/ips4o.hpp>
 
 #include <sorting/radix32.hpp>
+#include <sorting/adaptive.hpp>
+#include <sorting/network.hpp>
 
 namespace gsaca_lyndon {
 
@@ -17,23 +21,24 @@ template<typename sorter, typename F = flag_type<false>,
     bool measure_subgrouping = measure_all,
     bool measure_writing = measure_all>
 inline void
-phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
+phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const,
                    phase_2_group_type<buffer_type> const *const groups,
-                   size_t const number_of_groups) {
+                   size_t const number_of_groups, F const &flags) {
   LOG_VERBOSE << "Phase 2 call: " << number_of_groups << " groups" << std::endl;
 
   using count_type = get_count_type<index_type, buffer_type>;
   using key_value_pair = radix_key_val_pair<buffer_type>;
 
-  count_type max_group_size = 0;
-  for (count_type g = 0; g < number_of_groups; ++g) {
-    max_group_size = std::max(max_group_size, (count_type) groups[g].size);
-  }
+  std::vector<size_t> chain_groups;
+  size_t next_chain = 0;
+  count_type const max_group_size =
+      max_non_chain_group_size<F>(sa, groups, number_of_groups, chain_groups);
 
   constexpr count_type sg_count_threshold = 256ULL * 1024; // 1MiB buffer
-  void *memory = malloc(
+  void *memory = checked_malloc(
       sg_count_threshold * sizeof(count_type) +
-      ((max_group_size + 1) << 1) * sizeof(key_value_pair));
+      (((size_t) max_group_size + 1) << 1) * sizeof(key_value_pair));
+  scoped_free const memory_guard(memory);
 
   count_type *const subgroup_border_buffer = (count_type *) memory;
   key_value_pair *grouped_indices = (key_value_pair *) (subgroup_border_buffer +
@@ -61,6 +66,13 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
       sa[left_border] = F::remove_flag(sa[left_border]);
       isa[sa[left_border]] = left_border;
       ++left_border;
+    } else if ((gsize < runs_internal::chain_check_min)
+               ? is_single_chain<F>(&(sa[left_border]), gsize,
+                                    groups[g].lyndon)
+               : is_next_chain(chain_groups, next_chain, g)) {
+      phase_2_resolve_chain<F>(&(sa[left_border]), isa, left_border, gsize,
+                               flags);
+      left_border += gsize;
     } else {
       if constexpr(measure_subgrouping) tSg.begin();
 
@@ -87,7 +99,7 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
       count_type *const subgroup_border =
           (gsaca_likely(sg_count < sg_count_threshold))
           ? (subgroup_border_buffer)
-          : ((count_type *) malloc(sg_count * sizeof(count_type)));
+          : ((count_type *) checked_malloc(sg_count * sizeof(count_type)));
 
 
       count_type local_left_border = 0;
@@ -98,7 +110,8 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
 
       for (count_type i = 0; i < gsize; ++i) {
         count_type &border = subgroup_border[subgroup_id[i]];
-        grouped_indices[border++].value = sa_interval[i];
+        grouped_indices[border++].value =
+            convert_flagged<F, buffer_type>(sa_interval[i]);
       }
 
       if constexpr(measure_subgrouping) tSg.end();
@@ -110,9 +123,14 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
 
         if constexpr(measure_keyfetch) tFetch.begin();
         // retrieve lexicographical rank of inducers
+        uint64_t min_key = std::numeric_limits<uint64_t>::max();
+        uint64_t max_key = 0;
         for (count_type i = previous_border; i < stop; ++i) {
-          grouped_indices[i].key = isa[
+          buffer_type const key = isa[
               F::remove_flag(grouped_indices[i].value) + lyn];
+          grouped_indices[i].key = key;
+          min_key = std::min(min_key, (uint64_t) key);
+          max_key = std::max(max_key, (uint64_t) key);
         }
         if constexpr(measure_keyfetch) tFetch.end();
         if constexpr(measure_keyfetch) millisFetch += tFetch.millis();
@@ -124,15 +142,19 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
           sort_hists[std::min(65, (int) (stop - previous_border))]++;
         }
 
-        if (gsaca_likely(stop - previous_border < 33)) {
-          radix_internal::insertion<true>(
-              &(grouped_indices[previous_border]), stop - previous_border);
+        if (!sorts_small_inputs<sorter> &&
+            gsaca_likely(stop - previous_border < 33)) {
+          small_sort<true>(&(grouped_indices[previous_border]),
+                           stop - previous_border, max_key);
         } else {
-          // increasing sort, no need for stable sort
+          // increasing sort, no need for stable sort (the keys are not
+          // needed afterwards, so we can compress them)
+          compress_keys(&(grouped_indices[previous_border]),
+                        stop - previous_border, min_key, max_key);
           sorter::template sort<true, false>(
               &(grouped_indices[previous_border]),
               grouped_indices_buffer,
-              stop - previous_border, n - 1);
+              stop - previous_border, max_key);
         }
 
 
@@ -141,10 +163,11 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
 
         if constexpr(measure_writing) tWrite.begin();
         for (count_type i = previous_border; i < stop; ++i) {
-          sa_interval[i] = grouped_indices[i].value;
+          sa_interval[i] =
+              convert_flagged<F, index_type>(grouped_indices[i].value);
         }
         for (count_type i = previous_border; i < stop; ++i) {
-          if (!F::is_flagged(sa_interval[i])) {
+          if (!flags.is_flagged(sa_interval[i])) {
             isa[sa_interval[i]] = left_border + i;
           } else {
             sa_interval[i] = F::remove_flag(sa_interval[i]);
@@ -163,8 +186,6 @@ phase_2_by_sorting(index_type *const sa, buffer_type *const isa, size_t const n,
     }
   }
 
-  free(memory);
-
   if constexpr(measure_sorting) {
     LOG_STATS << "sorting" << millisSort;
     LOG_STATS << "sorting_avg_n" << sort_n_sum / sort_cnt;
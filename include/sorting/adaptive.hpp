@@ -0,0 +1,265 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "sorting/network.hpp"
+#include "sorting/radix32.hpp"
+
+namespace gsaca_lyndon {
+
+namespace adaptive_internal {
+
+// all thresholds that the ADAPTIVE sorter uses to pick an algorithm
+struct thresholds {
+  // inputs with at most this many elements are sorted by insertion sort (or
+  // a sorting network, see small_sort)
+  size_t insertion_max = 32;
+  // counting sort is used if max_key < counting_max_key and
+  // max_key < counting_range_factor * n
+  size_t counting_max_key = 1ULL << 16;
+  size_t counting_range_factor = 4;
+  // LSD is used instead of MSD if n >= lsd_ratio * 256^(key_bytes - 1)
+  double lsd_ratio = 8.0;
+  // unstable sorts of at least this many elements are done by IPS4O
+  size_t ips4o_min_n = 1ULL << 20;
+
+  bool write(std::string const &path) const {
+    std::ofstream out(path);
+    out << "gsaca-adaptive-sort 1\n"
+        << "insertion_max " << insertion_max << "\n"
+        << "counting_max_key " << counting_max_key << "\n"
+        << "counting_range_factor " << counting_range_factor << "\n"
+        << "lsd_ratio " << lsd_ratio << "\n"
+        << "ips4o_min_n " << ips4o_min_n << "\n";
+    return out.good();
+  }
+
+  bool read(std::string const &path) {
+    std::ifstream in(path);
+    std::string key;
+    uint64_t version = 0;
+    if (!(in >> key >> version) || key != "gsaca-adaptive-sort" ||
+        version != 1) {
+      return false;
+    }
+    thresholds result;
+    auto const value = [&](auto &field) {
+        if (!(in >> field)) {
+          throw std::runtime_error("gsaca_lyndon: invalid value of " + key +
+                                   " in " + path);
+        }
+    };
+    while (in >> key) {
+      if (key == "insertion_max") value(result.insertion_max);
+      else if (key == "counting_max_key") value(result.counting_max_key);
+      else if (key == "counting_range_factor")
+        value(result.counting_range_factor);
+      else if (key == "lsd_ratio") value(result.lsd_ratio);
+      else if (key == "ips4o_min_n") value(result.ips4o_min_n);
+      else return false;
+    }
+    *this = result;
+    return true;
+  }
+
+  std::string to_string() const {
+    std::stringstream ss;
+    ss << "insertion_max=" << insertion_max
+       << " counting_max_key=" << counting_max_key
+       << " counting_range_factor=" << counting_range_factor
+       << " lsd_ratio=" << lsd_ratio
+       << " ips4o_min_n=" << ips4o_min_n;
+    return ss.str();
+  }
+};
+
+template<bool increasing, typename data_type, typename count_type>
+static inline void counting(data_type *const data, data_type *const buffer,
+                            count_type const n, size_t const max_key) {
+  static thread_local std::vector<count_type> histogram;
+  histogram.assign(max_key + 1, 0);
+  for (count_type i = 0; i < n; ++i) {
+    ++histogram[data[i].key];
+  }
+
+  count_type l = 0;
+  if constexpr (increasing) {
+    for (size_t k = 0; k <= max_key; ++k) {
+      count_type const bucket_size = histogram[k];
+      histogram[k] = l;
+      l += bucket_size;
+    }
+  } else {
+    for (size_t k = max_key + 1; k > 0; --k) {
+      count_type const bucket_size = histogram[k - 1];
+      histogram[k - 1] = l;
+      l += bucket_size;
+    }
+  }
+
+  for (count_type i = 0; i < n; ++i) {
+    buffer[histogram[data[i].key]++] = data[i];
+  }
+  for (count_type i = 0; i < n; ++i) {
+    data[i] = buffer[i];
+  }
+}
+
+
+// One-off micro-benchmark that determines the thresholds of ADAPTIVE on the
+// current machine. Takes a few seconds.
+inline thresholds calibrate() {
+  using pair_type = radix_key_val_pair<uint32_t>;
+  constexpr size_t max_n = 1ULL << 18;
+
+  std::mt19937_64 gen(4711);
+  std::vector<pair_type> input(max_n);
+  // one slot of padding to the left for insertion sort
+  std::vector<pair_type> data(max_n + 1);
+  std::vector<pair_type> buffer(max_n);
+
+  auto measure = [&](size_t const n, size_t const max_key, auto &&sort) {
+      size_t const reps = std::max((size_t) 1, (size_t) (1ULL << 21) / n);
+      for (size_t i = 0; i < max_n; ++i) {
+        input[i] = pair_type{(uint32_t) (gen() % (max_key + 1)),
+                             (uint32_t) i};
+      }
+      auto const begin = std::chrono::high_resolution_clock::now();
+      for (size_t r = 0; r < reps; ++r) {
+        size_t const offset = (r * n) % (max_n - n + 1);
+        std::copy_n(input.begin() + offset, n, data.begin() + 1);
+        sort(data.data() + 1, buffer.data(), n, max_key);
+      }
+      auto const end = std::chrono::high_resolution_clock::now();
+      return std::chrono::duration<double>(end - begin).count();
+  };
+  auto by_insertion = [](pair_type *d, pair_type *, size_t n,
+                         size_t max_key) {
+      small_sort<true>(d, n, max_key);
+  };
+  auto by_msd = [](pair_type *d, pair_type *b, size_t n, size_t max_key) {
+      msd_radix<true>(d, b, n, max_key);
+  };
+  auto by_lsd = [](pair_type *d, pair_type *b, size_t n, size_t max_key) {
+      lsd_radix<true>(d, b, n, max_key);
+  };
+  auto by_counting = [](pair_type *d, pair_type *b, size_t n,
+                        size_t max_key) {
+      counting<true>(d, b, n, max_key);
+  };
+
+  thresholds result;
+
+  // insertion sort vs. MSD (ranks in phase 2 are spread over 3-4 bytes)
+  result.insertion_max = 8;
+  for (size_t n : {12, 16, 24, 32, 48, 64, 96, 128}) {
+    if (measure(n, 1ULL << 24, by_insertion) <
+        measure(n, 1ULL << 24, by_msd)) {
+      result.insertion_max = n;
+    }
+  }
+
+  // counting sort vs. MSD for different key ranges
+  result.counting_range_factor = 0;
+  for (size_t factor : {1, 2, 4, 8, 16}) {
+    size_t const n = 4096;
+    if (measure(n, factor * n - 1, by_counting) <
+        measure(n, factor * n - 1, by_msd)) {
+      result.counting_range_factor = factor;
+    }
+  }
+
+  // LSD vs. MSD for two byte keys (never LSD if it loses at max_n)
+  result.lsd_ratio = std::numeric_limits<double>::max();
+  for (size_t n = max_n; n >= 256; n >>= 1) {
+    if (measure(n, (1ULL << 16) - 1, by_lsd) <
+        measure(n, (1ULL << 16) - 1, by_msd)) {
+      result.lsd_ratio = n / 256.0;
+    } else {
+      break;
+    }
+  }
+  return result;
+}
+
+// Reads the thresholds from the given file. If the file does not exist (or
+// is outdated), the thresholds are calibrated and written to the file. Throws
+// std::runtime_error if a value in the file cannot be parsed.
+inline thresholds load_or_calibrate(std::string const &path) {
+  thresholds result;
+  if (!result.read(path)) {
+    std::cout << "Calibrating adaptive sorter (" << path << ")..."
+              << std::endl;
+    result = calibrate();
+    if (!result.write(path)) {
+      std::cerr << "Could not write adaptive sorter config to " << path
+                << std::endl;
+    }
+  }
+  return result;
+}
+
+// The thresholds used by ADAPTIVE. On first use, they are loaded from (or
+// calibrated and stored to) $GSACA_LYNDON_SORT_CONFIG if the variable is set.
+inline thresholds &config() {
+  static thresholds result = []() {
+      char const *const path = std::getenv("GSACA_LYNDON_SORT_CONFIG");
+      return (path == nullptr) ? thresholds() : load_or_calibrate(path);
+  }();
+  return result;
+}
+
+} // namespace adaptive_internal
+
+// Picks insertion sort, counting sort, LSD, MSD or IPS4O for each call,
+// depending on the number of elements and the key range.
+struct ADAPTIVE {
+  // the sorter also takes care of tiny inputs (see phase_2_by_sorting)
+  static constexpr bool sorts_small_inputs = true;
+
+  template<bool increasing = true, bool stable = true, typename data_type>
+  static inline void
+  sort(data_type *const data, data_type *const buffer, size_t const n,
+       size_t const max_key = radix_internal::key_max<data_type>) {
+    auto const &t = adaptive_internal::config();
+    if (n <= t.insertion_max) {
+      small_sort<increasing>(data, n, max_key);
+      return;
+    }
+    if constexpr (!stable) {
+      if (gsaca_unlikely(n >= t.ips4o_min_n)) {
+        IPS4O::sort<increasing>(data, buffer, n, max_key);
+        return;
+      }
+    }
+    if (max_key < t.counting_max_key &&
+        max_key < t.counting_range_factor * n) {
+      adaptive_internal::counting<increasing>(data, buffer, n, max_key);
+      return;
+    }
+    uint8_t const key_bytes = radix_key_bytes(max_key);
+    double const msd_limit = t.lsd_ratio * (1ULL << ((key_bytes - 1) << 3));
+    if (n >= msd_limit) {
+      radix_internal::lsd_radix_internal<increasing>(data, buffer, n,
+                                                     key_bytes);
+    } else {
+      radix_internal::msd_radix_internal<increasing>(data, buffer, n,
+                                                     key_bytes);
+    }
+  }
+
+  static std::string id() {
+    return "adaptive";
+  }
+};
+
+} // namespace gsaca_lyndon
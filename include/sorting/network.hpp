@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "sorting/radix32.hpp"
+
+namespace gsaca_lyndon {
+
+namespace network_internal {
+
+// largest number of elements that can be sorted by a network
+constexpr size_t network_max = 32;
+// for this many elements (or less) insertion sort is faster
+constexpr size_t insertion_max = 4;
+constexpr uint8_t slot_bits = 5;
+// keys must fit into the remaining bits of the packed 64-bit word
+constexpr uint64_t packed_key_max = (1ULL << (64 - slot_bits)) - 1;
+
+// eight packed words; GCC lowers this to AVX-512, AVX2 or SSE (depending on
+// the target) and we do not need any intrinsics
+typedef uint64_t vec_type __attribute__((vector_size(64)));
+typedef int64_t mask_type __attribute__((vector_size(64)));
+
+// The helpers take vectors by reference, passing them by value is not
+// ABI-stable below AVX-512 (-Wpsabi). lo/hi may alias a/b.
+gsaca_always_inline void min_max(vec_type const &a, vec_type const &b,
+                                 vec_type &lo, vec_type &hi) {
+  mask_type const less = a < b;
+  vec_type const min = less ? a : b;
+  vec_type const max = less ? b : a;
+  lo = min;
+  hi = max;
+}
+
+gsaca_always_inline void reverse(vec_type &a) {
+  a = __builtin_shuffle(a, mask_type{7, 6, 5, 4, 3, 2, 1, 0});
+}
+
+// compare-exchange lanes i and (i ^ m); lanes with (i & h) get the maximum
+template<int64_t m, int64_t h>
+gsaca_always_inline void lanes(vec_type &a) {
+  vec_type const b = __builtin_shuffle(
+      a, mask_type{0 ^ m, 1 ^ m, 2 ^ m, 3 ^ m, 4 ^ m, 5 ^ m, 6 ^ m, 7 ^ m});
+  mask_type const upper = {0 & h, 1 & h, 2 & h, 3 & h,
+                           4 & h, 5 & h, 6 & h, 7 & h};
+  vec_type lo, hi;
+  min_max(a, b, lo, hi);
+  a = (upper != 0) ? hi : lo;
+}
+
+// last three levels of each merge (distance 4, 2 and 1)
+gsaca_always_inline void clean(vec_type &a) {
+  lanes<4, 4>(a);
+  lanes<2, 2>(a);
+  lanes<1, 1>(a);
+}
+
+// sort each vector
+gsaca_always_inline void sort8(vec_type &a) {
+  lanes<1, 1>(a);
+  lanes<3, 2>(a);
+  lanes<1, 1>(a);
+  lanes<7, 4>(a);
+  lanes<2, 2>(a);
+  lanes<1, 1>(a);
+}
+
+// merge two sorted sequences, the second one is read backwards ("flip")
+gsaca_always_inline void flip(vec_type &a, vec_type &b) {
+  reverse(b);
+  min_max(a, b, a, b);
+  reverse(b);
+}
+
+gsaca_always_inline void exchange(vec_type &a, vec_type &b) {
+  min_max(a, b, a, b);
+}
+
+// Bitonic sorting network on V * 8 packed words. Each merge starts with a
+// flip, so all compare-exchanges are ascending.
+template<size_t V>
+static inline void bitonic(vec_type *const v) {
+  static_assert(V == 1 || V == 2 || V == 4);
+  for (size_t i = 0; i < V; ++i) sort8(v[i]);
+  if constexpr (V >= 2) {
+    for (size_t i = 0; i < V; i += 2) flip(v[i], v[i + 1]);
+    for (size_t i = 0; i < V; ++i) clean(v[i]);
+  }
+  if constexpr (V == 4) {
+    flip(v[0], v[3]);
+    flip(v[1], v[2]);
+    exchange(v[0], v[1]);
+    exchange(v[2], v[3]);
+    for (size_t i = 0; i < V; ++i) clean(v[i]);
+  }
+}
+
+template<size_t V, bool increasing, typename data_type>
+static inline void network(data_type *const data, size_t const n) {
+  // pack key and position into one word (the position makes it stable)
+  vec_type v[V];
+  uint64_t *const packed = (uint64_t *) v;
+  data_type copy[V * 8];
+  for (size_t i = 0; i < n; ++i) {
+    uint64_t const key = (uint64_t) data[i].key;
+    uint64_t const packed_key = increasing ? key : (packed_key_max - key);
+    packed[i] = (packed_key << slot_bits) | i;
+    copy[i] = data[i];
+  }
+  for (size_t i = n; i < V * 8; ++i) {
+    packed[i] = std::numeric_limits<uint64_t>::max();
+  }
+
+  bitonic<V>(v);
+
+  for (size_t i = 0; i < n; ++i) {
+    data[i] = copy[packed[i] & (network_max - 1)];
+  }
+}
+
+} // namespace network_internal
+
+// Sorts up to 32 key/value pairs with a branchless sorting network. Keys must
+// not exceed network_internal::packed_key_max (i.e., at most 59 bits).
+template<bool increasing = true, typename data_type>
+static inline void network_sort(data_type *const data, size_t const n) {
+  static_assert(radix_internal::key_size<data_type> <= 8);
+  using namespace network_internal;
+  if (n <= 8) {
+    if (n > 1) network<1, increasing>(data, n);
+  } else if (n <= 16) {
+    network<2, increasing>(data, n);
+  } else {
+    network<4, increasing>(data, n);
+  }
+}
+
+// Whether network_sort can be used for keys up to max_key.
+static inline bool network_sortable(size_t const n, uint64_t const max_key) {
+  return n <= network_internal::network_max &&
+         max_key <= network_internal::packed_key_max;
+}
+
+// Sorts tiny inputs with insertion sort or a sorting network. Like insertion
+// sort, this requires one element of space to the left of data.
+template<bool increasing = true, typename data_type>
+static inline void
+small_sort(data_type *const data, size_t const n, uint64_t const max_key) {
+  if (n > network_internal::insertion_max && network_sortable(n, max_key)) {
+    network_sort<increasing>(data, n);
+  } else if (n > 1) {
+    radix_internal::insertion<increasing>(data, n);
+  }
+}
+
+} // namespace gsaca_lyndon
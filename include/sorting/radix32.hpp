@@ -1,10 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <new>
+#include <string>
 #include "ips4o.hpp"
 #include "common/uint_types.hpp"
 
 namespace gsaca_lyndon {
 
+// memory layout of the key/value pairs during radix sort
+enum class radix_layout {
+  interleaved, // sort the key/value pairs directly
+  soa,         // sort separate arrays of keys and positions
+  packed       // sort key and value (or position) packed into 64-bit words
+};
+
 namespace radix_internal {
 
 // this seems to work best
@@ -31,7 +41,8 @@ bool compare(key_type const &a, key_type const &b) {
 template<bool increasing, typename data_type, typename count_type>
 static inline void insertion(data_type *const data, count_type const n) {
   using key_type = key_type<data_type>;
-  static_assert(std::is_unsigned_v<key_type>);
+  static_assert(std::is_unsigned_v<key_type> ||
+                std::is_same_v<key_type, uint128_t>);
   // luxury: we have space to the left!
   key_type h = data[-1].key;
   if constexpr (increasing)
@@ -103,42 +114,36 @@ static inline void msd_radix_internal(data_type *const data,
 }
 
 
-template<bool increasing, int key_bytes_tmp = -1,
-    typename data_type, typename count_type>
-static inline void msd_radix_internal(data_type *const data,
+template<bool increasing, size_t byte, typename data_type,
+    typename count_type>
+static inline void msd_radix_dispatch(data_type *const data,
                                       data_type *const buffer,
                                       count_type const n,
                                       uint8_t const key_bytes) {
-  if constexpr (radix_internal::key_size<data_type> > 4) {
-    if (key_bytes == 5) {
-      msd_radix_internal<increasing, 4>(data, buffer, n);
-      for (count_type i = 0; i < n; ++i) {
-        data[i] = buffer[i];
-      }
+  if constexpr (byte > 0) {
+    if (key_bytes <= byte) {
+      msd_radix_dispatch<increasing, byte - 1>(data, buffer, n, key_bytes);
       return;
     }
   }
-
-  if (key_bytes == 4) {
-    msd_radix_internal<increasing, 3>(data, buffer, n);
-  }
-  else if (key_bytes == 3) {
-    msd_radix_internal<increasing, 2>(data, buffer, n);
-    for (count_type i = 0; i < n; ++i) {
-      data[i] = buffer[i];
-    }
-  }
-  else if (key_bytes == 2) {
-    msd_radix_internal<increasing, 1>(data, buffer, n);
-  }
-  else {
-    msd_radix_internal<increasing, 0>(data, buffer, n);
+  msd_radix_internal<increasing, byte>(data, buffer, n);
+  // the result ends up in the buffer if the top byte is even
+  if constexpr (byte % 2 == 0) {
     for (count_type i = 0; i < n; ++i) {
       data[i] = buffer[i];
     }
   }
 }
 
+template<bool increasing, typename data_type, typename count_type>
+static inline void msd_radix_internal(data_type *const data,
+                                      data_type *const buffer,
+                                      count_type const n,
+                                      uint8_t const key_bytes) {
+  msd_radix_dispatch<increasing, key_size<data_type> - 1>(data, buffer, n,
+                                                          key_bytes);
+}
+
 // LSD RADIX SORT ==============================================================
 template<bool increasing, size_t byte = 0,
     typename data_type, typename count_type>
@@ -181,14 +186,311 @@ lsd_radix_internal(data_type *data, data_type *buffer, count_type const n,
   }
 }
 
+// SOA AND PACKED LAYOUTS =====================================================
+// Instead of moving the (possibly unaligned) key/value pairs in every radix
+// pass, we either sort separate arrays of keys and 32-bit positions and apply
+// the permutation once at the end (soa), or pack everything into one 64-bit
+// word per pair (packed).
+
+// growable scratch memory (one per thread)
+static inline void *scratch(size_t const bytes) {
+  static thread_local struct scratch_type {
+    void *memory = nullptr;
+    size_t size = 0;
+
+    ~scratch_type() {
+      free(memory);
+    }
+  } s;
+  if (s.size < bytes) {
+    free(s.memory);
+    s.memory = malloc(bytes);
+    if (gsaca_unlikely(s.memory == nullptr)) {
+      s.size = 0;
+      throw std::bad_alloc();
+    }
+    s.size = bytes;
+  }
+  return s.memory;
 }
 
+static inline uint8_t bit_width(uint64_t const x) {
+  return (x == 0) ? 0 : (64 - __builtin_clzll(x));
+}
+
+template<bool increasing, typename key_type, typename slot_type>
+static inline void soa_insertion(key_type *const keys, slot_type *const slots,
+                                 size_t const n) {
+  for (size_t i = 1; i < n; ++i) {
+    key_type const insert_key = keys[i];
+    slot_type const insert_slot = slots[i];
+    size_t insertion_index = i;
+    while (insertion_index > 0 &&
+           compare<!increasing>(keys[insertion_index - 1], insert_key)) {
+      keys[insertion_index] = keys[insertion_index - 1];
+      slots[insertion_index] = slots[insertion_index - 1];
+      --insertion_index;
+    }
+    keys[insertion_index] = insert_key;
+    slots[insertion_index] = insert_slot;
+  }
+}
+
+template<bool increasing, typename key_type, typename slot_type>
+static inline void soa_msd(key_type *const keys, slot_type *const slots,
+                           key_type *const key_buffer,
+                           slot_type *const slot_buffer, size_t const n,
+                           uint8_t const byte, bool const result_in_buffer) {
+  if (n < insertion_threshold) {
+    soa_insertion<increasing>(keys, slots, n);
+    if (result_in_buffer) {
+      std::copy_n(keys, n, key_buffer);
+      std::copy_n(slots, n, slot_buffer);
+    }
+    return;
+  }
+
+  uint8_t const key_shift = byte * 8;
+  size_t histogram[256] = {};
+  for (size_t i = 0; i < n; ++i) {
+    ++histogram[(keys[i] >> key_shift) & 0xFF];
+  }
+
+  constexpr int start_bucket = increasing ? 0 : 255;
+  constexpr int stop_bucket = increasing ? 256 : -1;
+  constexpr int inc = increasing ? 1 : -1;
+  size_t l = 0;
+  for (int i = start_bucket; i != stop_bucket; i += inc) {
+    size_t const bucket_size = histogram[i];
+    histogram[i] = l;
+    l += bucket_size;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    size_t const pos = histogram[(keys[i] >> key_shift) & 0xFF]++;
+    key_buffer[pos] = keys[i];
+    slot_buffer[pos] = slots[i];
+  }
+
+  if (byte == 0) {
+    if (!result_in_buffer) {
+      std::copy_n(key_buffer, n, keys);
+      std::copy_n(slot_buffer, n, slots);
+    }
+    return;
+  }
+
+  l = 0;
+  for (int i = start_bucket; i != stop_bucket; i += inc) {
+    size_t const bucket_size = histogram[i] - l;
+    if (bucket_size > 0) {
+      soa_msd<increasing>(key_buffer + l, slot_buffer + l, keys + l,
+                          slots + l, bucket_size, byte - 1,
+                          !result_in_buffer);
+      l += bucket_size;
+    }
+  }
+}
+
+// returns true if the sorted keys are in the buffers afterwards
+template<bool increasing, typename key_type, typename slot_type>
+static inline bool soa_lsd(key_type *keys, slot_type *slots,
+                           key_type *key_buffer, slot_type *slot_buffer,
+                           size_t const n, uint8_t const key_bytes) {
+  constexpr int start_bucket = increasing ? 0 : 255;
+  constexpr int stop_bucket = increasing ? 256 : -1;
+  constexpr int inc = increasing ? 1 : -1;
+  for (uint8_t byte = 0; byte < key_bytes; ++byte) {
+    uint8_t const key_shift = byte * 8;
+    size_t histogram[256] = {};
+    for (size_t i = 0; i < n; ++i) {
+      ++histogram[(keys[i] >> key_shift) & 0xFF];
+    }
+    size_t l = 0;
+    for (int i = start_bucket; i != stop_bucket; i += inc) {
+      size_t const bucket_size = histogram[i];
+      histogram[i] = l;
+      l += bucket_size;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      size_t const pos = histogram[(keys[i] >> key_shift) & 0xFF]++;
+      key_buffer[pos] = keys[i];
+      slot_buffer[pos] = slots[i];
+    }
+    std::swap(keys, key_buffer);
+    std::swap(slots, slot_buffer);
+  }
+  return key_bytes % 2;
+}
+
+template<bool increasing, bool msd, typename data_type>
+static inline bool soa_sort(data_type *const data, data_type *const buffer,
+                            size_t const n, size_t const max_key) {
+  using key_type = key_type<data_type>;
+  using value_type = typename std::remove_reference<
+      decltype(std::declval<data_type>().value)>::type;
+  using slot_type = uint32_t;
+  if (n > std::numeric_limits<slot_type>::max()) return false;
+
+  key_type *const keys = (key_type *) scratch(
+      2 * n * (sizeof(key_type) + sizeof(slot_type)));
+  key_type *const key_buffer = keys + n;
+  slot_type *const slots = (slot_type *) (key_buffer + n);
+  slot_type *const slot_buffer = slots + n;
+  value_type *const values = (value_type *) buffer;
+
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = data[i].key;
+    slots[i] = i;
+    values[i] = data[i].value;
+  }
+
+  uint8_t const key_bytes = (bit_width(max_key | 1) + 7) >> 3;
+  bool result_in_buffer = false;
+  if constexpr (msd) {
+    soa_msd<increasing>(keys, slots, key_buffer, slot_buffer, n,
+                        key_bytes - 1, false);
+  } else {
+    result_in_buffer = soa_lsd<increasing>(keys, slots, key_buffer,
+                                           slot_buffer, n, key_bytes);
+  }
+
+  key_type const *const sorted_keys = result_in_buffer ? key_buffer : keys;
+  slot_type const *const sorted_slots =
+      result_in_buffer ? slot_buffer : slots;
+  for (size_t i = 0; i < n; ++i) {
+    data[i].key = sorted_keys[i];
+    data[i].value = values[sorted_slots[i]];
+  }
+  return true;
+}
+
+// (packed: the words overlay key/value pairs, which need not be 8-byte aligned)
+struct packed_word {
+  uint64_t key;
+} __attribute__((packed));
+
+template<bool msd>
+static inline void sort_packed_words(packed_word *const words,
+                                     packed_word *const buffer,
+                                     size_t const n, uint8_t const bits) {
+  uint8_t const key_bytes = (bits + 7) >> 3;
+  if constexpr (msd) {
+    msd_radix_internal<true>(words, buffer, n, key_bytes);
+  } else {
+    lsd_radix_internal<true>(words, buffer, n, key_bytes);
+  }
+}
+
+// Unstable sorts pack (key, value) into one word, which can be done in place
+// (pairs are at least as large as words). Stable sorts pack (key, position)
+// and move the pairs to their final position afterwards.
+template<bool increasing, bool stable, bool msd, typename data_type>
+static inline bool packed_sort(data_type *const data, data_type *const buffer,
+                               size_t const n, size_t const max_key) {
+  static_assert(sizeof(data_type) >= sizeof(packed_word));
+  using key_type = key_type<data_type>;
+  uint8_t const key_bits = bit_width(max_key | 1);
+  auto const encode = [&](uint64_t const key) {
+      return increasing ? key : (max_key - key);
+  };
+  packed_word *const words = (packed_word *) data;
+
+  if constexpr (!stable) {
+    uint64_t all_values = 0;
+    for (size_t i = 0; i < n; ++i) {
+      all_values |= (uint64_t) data[i].value;
+    }
+    uint8_t const value_bits = bit_width(all_values);
+    if (key_bits + value_bits > 64) return false;
+
+    // forward, because word i does not overlap any pair behind pair i
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t const key = (uint64_t) data[i].key;
+      uint64_t const value = (uint64_t) data[i].value;
+      words[i].key = (encode(key) << value_bits) | value;
+    }
+    sort_packed_words<msd>(words, (packed_word *) buffer, n,
+                           key_bits + value_bits);
+    // backward, because pair i does not overlap any word in front of word i
+    uint64_t const value_mask = (1ULL << value_bits) - 1;
+    for (size_t i = n; i > 0; --i) {
+      uint64_t const word = words[i - 1].key;
+      data[i - 1].key = (key_type) encode(word >> value_bits);
+      data[i - 1].value = word & value_mask;
+    }
+  } else {
+    uint8_t const slot_bits = bit_width(n - 1);
+    if (key_bits + slot_bits > 64) return false;
+
+    std::copy_n(data, n, buffer);
+    for (size_t i = 0; i < n; ++i) {
+      words[i].key = (encode((uint64_t) buffer[i].key) << slot_bits) | i;
+    }
+    // one more word to the left of the buffer (see insertion)
+    packed_word *const word_buffer =
+        (packed_word *) scratch((n + 1) * sizeof(packed_word)) + 1;
+    sort_packed_words<msd>(words, word_buffer, n, key_bits + slot_bits);
+    uint64_t const slot_mask = (1ULL << slot_bits) - 1;
+    for (size_t i = n; i > 0; --i) {
+      data[i - 1] = buffer[words[i - 1].key & slot_mask];
+    }
+  }
+  return true;
+}
+
+template<radix_layout layout, bool msd, bool increasing, bool stable,
+    typename data_type>
+static inline bool sort_with_layout(data_type *const data,
+                                    data_type *const buffer,
+                                    size_t const n, size_t const max_key) {
+  if (n < insertion_threshold) return false;
+  if constexpr (layout == radix_layout::soa) {
+    return soa_sort<increasing, msd>(data, buffer, n, max_key);
+  } else if constexpr (layout == radix_layout::packed &&
+                       sizeof(data_type) >= sizeof(packed_word)) {
+    return packed_sort<increasing, stable, msd>(data, buffer, n, max_key);
+  } else {
+    return false;
+  }
+}
+
+static inline std::string layout_suffix(radix_layout const layout) {
+  if (layout == radix_layout::soa) return "-soa";
+  if (layout == radix_layout::packed) return "-packed";
+  return "";
+}
+
+}
+
+
+// number of bytes (i.e., radix passes) needed for keys up to max_key
+static inline uint8_t radix_key_bytes(uint64_t const max_key) {
+  return (71 - __builtin_clzl(max_key | 1)) >> 3;
+}
+
+// If subtracting the smallest key saves radix passes, subtract it from all
+// keys and update max_key accordingly. Returns the subtracted offset.
+template<typename data_type>
+static inline uint64_t compress_keys(data_type *const data, size_t const n,
+                                     uint64_t const min_key,
+                                     uint64_t &max_key) {
+  using key_type = radix_internal::key_type<data_type>;
+  if (radix_key_bytes(max_key - min_key) >= radix_key_bytes(max_key)) {
+    return 0;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    data[i].key = (key_type) ((uint64_t) data[i].key - min_key);
+  }
+  max_key -= min_key;
+  return min_key;
+}
 
 template<bool increasing = true, typename data_type>
 static inline void
 lsd_radix(data_type *const data, data_type *const buffer, size_t const n,
           size_t const max_key) {
-  uint8_t const key_bytes = (71 - __builtin_clzl(max_key)) >> 3;
+  uint8_t const key_bytes = radix_key_bytes(max_key);
   radix_internal::lsd_radix_internal<increasing>(data, buffer, n, key_bytes);
 }
 
@@ -196,36 +498,51 @@ template<bool increasing = true, typename data_type>
 static inline void
 msd_radix(data_type *const data, data_type *const buffer, size_t const n,
           size_t const max_key) {
-  uint8_t const key_bytes = (71 - __builtin_clzl(max_key)) >> 3;
+  uint8_t const key_bytes = radix_key_bytes(max_key);
   radix_internal::msd_radix_internal<increasing>(data, buffer, n, key_bytes);
 }
 
-struct MSD {
+template<radix_layout layout = radix_layout::interleaved>
+struct msd_sorter {
   template<bool increasing = true, bool stable = true, typename data_type>
   static inline void
   sort(data_type *const data, data_type *const buffer, size_t const n,
        size_t const max_key = radix_internal::key_max<data_type>) {
-    msd_radix<increasing>(data, buffer, n, max_key);
+    if (!radix_internal::sort_with_layout<layout, true, increasing, stable>(
+        data, buffer, n, max_key)) {
+      msd_radix<increasing>(data, buffer, n, max_key);
+    }
   }
 
   static std::string id() {
-    return "msd";
+    return "msd" + radix_internal::layout_suffix(layout);
   }
 };
 
-struct LSD {
+template<radix_layout layout = radix_layout::interleaved>
+struct lsd_sorter {
   template<bool increasing = true, bool stable = true, typename data_type>
   static inline void
   sort(data_type *const data, data_type *const buffer, size_t const n,
        size_t const max_key = radix_internal::key_max<data_type>) {
-    lsd_radix<increasing>(data, buffer, n, max_key);
+    if (!radix_internal::sort_with_layout<layout, false, increasing, stable>(
+        data, buffer, n, max_key)) {
+      lsd_radix<increasing>(data, buffer, n, max_key);
+    }
   }
 
   static std::string id() {
-    return "lsd";
+    return "lsd" + radix_internal::layout_suffix(layout);
   }
 };
 
+using MSD = msd_sorter<radix_layout::interleaved>;
+using MSD_SOA = msd_sorter<radix_layout::soa>;
+using MSD_PACKED = msd_sorter<radix_layout::packed>;
+using LSD = lsd_sorter<radix_layout::interleaved>;
+using LSD_SOA = lsd_sorter<radix_layout::soa>;
+using LSD_PACKED = lsd_sorter<radix_layout::packed>;
+
 struct IPS4O {
   template<bool increasing = true, bool stable = false, typename data_type>
   static inline void
@@ -276,6 +593,17 @@ struct AUTO {
   }
 };
 
+// Sorters that handle tiny inputs efficiently themselves declare
+// "static constexpr bool sorts_small_inputs = true". For all other sorters,
+// tiny inputs are sorted by insertion sort before calling the sorter.
+template<typename sorter, typename = void>
+constexpr static bool sorts_small_inputs = false;
+
+template<typename sorter>
+constexpr static bool sorts_small_inputs<sorter,
+    std::void_t<decltype(sorter::sorts_small_inputs)>> =
+    sorter::sorts_small_inputs;
+
 template<typename key_type, typename value_type = key_type>
 struct radix_key_val_pair {
   key_type key;
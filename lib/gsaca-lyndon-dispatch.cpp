@@ -0,0 +1,61 @@
+#include "gsaca-lyndon.h"
+
+// Multi-ISA builds contain the entry points of gsaca-lyndon.cpp three times,
+// compiled for x86-64-v2, x86-64-v3 (AVX2) and x86-64-v4 (AVX-512). The
+// dynamic loader picks the best copy for the CPU once (via GNU indirect
+// functions), so calls have no dispatch overhead.
+
+#if !defined(__GNUC__) || defined(__clang__) || __GNUC__ < 12
+#error "GSACA_LYNDON_MULTI_ISA requires GCC 12 or newer"
+#endif
+
+namespace {
+
+enum class isa_level {
+  v2, v3, v4
+};
+
+isa_level detect_isa_level() {
+  // resolvers may run before the constructors
+  __builtin_cpu_init();
+  // check the complete levels, -march=x86-64-v3 may also emit lzcnt, movbe or
+  // f16c instructions (GCC 12 and newer)
+  if (__builtin_cpu_supports("x86-64-v4")) return isa_level::v4;
+  if (__builtin_cpu_supports("x86-64-v3")) return isa_level::v3;
+  return isa_level::v2;
+}
+
+} // namespace
+
+#define GSACA_LYNDON_RESOLVE(name, ...)                                        \
+  int name##_v2(__VA_ARGS__);                                                  \
+  int name##_v3(__VA_ARGS__);                                                  \
+  int name##_v4(__VA_ARGS__);                                                  \
+  static auto resolve_##name() -> int (*)(__VA_ARGS__) {                       \
+    switch (detect_isa_level()) {                                              \
+      case isa_level::v4: return name##_v4;                                    \
+      case isa_level::v3: return name##_v3;                                    \
+      default: return name##_v2;                                               \
+    }                                                                          \
+  }                                                                            \
+  int name(__VA_ARGS__) __attribute__((ifunc("resolve_" #name)));
+
+#define GSACA_LYNDON_DISPATCH(text_name, text_type, sa_name, sa_type)          \
+  GSACA_LYNDON_RESOLVE(gsaca_lyndon_##text_name##_##sa_name,                   \
+                       const text_type *, sa_type *, uint64_t)                 \
+  GSACA_LYNDON_RESOLVE(gsaca_lyndon_##text_name##_##sa_name##_par,             \
+                       const text_type *, sa_type *, uint64_t, unsigned int)
+
+extern "C" {
+
+GSACA_LYNDON_DISPATCH(u8, uint8_t, u32, uint32_t)
+GSACA_LYNDON_DISPATCH(u8, uint8_t, u40, uint8_t)
+GSACA_LYNDON_DISPATCH(u8, uint8_t, u64, uint64_t)
+GSACA_LYNDON_DISPATCH(u16, uint16_t, u32, uint32_t)
+GSACA_LYNDON_DISPATCH(u16, uint16_t, u40, uint8_t)
+GSACA_LYNDON_DISPATCH(u16, uint16_t, u64, uint64_t)
+GSACA_LYNDON_DISPATCH(u32, uint32_t, u32, uint32_t)
+GSACA_LYNDON_DISPATCH(u32, uint32_t, u40, uint8_t)
+GSACA_LYNDON_DISPATCH(u32, uint32_t, u64, uint64_t)
+
+} // extern "C"
@@ -0,0 +1,64 @@
+// Multi-ISA builds (see gsaca-lyndon-dispatch.cpp) compile this file once per
+// instruction set. Each copy uses its own namespace, such that inline and
+// template functions are not merged across copies, and entry points with the
+// instruction set as suffix (e.g., gsaca_lyndon_u8_u32_v3).
+#ifdef GSACA_LYNDON_ISA
+#define GSACA_LYNDON_CAT(a, b) GSACA_LYNDON_CAT_(a, b)
+#define GSACA_LYNDON_CAT_(a, b) a##_##b
+#define gsaca_lyndon GSACA_LYNDON_CAT(gsaca_lyndon, GSACA_LYNDON_ISA)
+#define GSACA_LYNDON_ENTRY(name) GSACA_LYNDON_CAT(name, GSACA_LYNDON_ISA)
+#else
+#define GSACA_LYNDON_ENTRY(name) name
+#endif
+
+#include "gsaca-lyndon.h"
+#include "gsaca-lyndon.hpp"
+
+#include <new>
+
+namespace {
+
+template<typename index_type, typename value_type, typename sa_type>
+int build(value_type const *const text, sa_type *const sa, uint64_t const n,
+          size_t const threads) {
+  if (n < 2 || text == nullptr || sa == nullptr) return -1;
+  try {
+    gsaca_lyndon::build_options options;
+    options.threads = threads;
+    gsaca_lyndon::build_sa(text, (index_type *) sa, n, options);
+  } catch (std::length_error const &) {
+    return -1;
+  } catch (std::bad_alloc const &) {
+    return -2;
+  } catch (...) {
+    // no exception may leave the C interface
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace
+
+#define GSACA_LYNDON_DEFINE(text_name, text_type, sa_name, sa_type, index_type)\
+  int GSACA_LYNDON_ENTRY(gsaca_lyndon_##text_name##_##sa_name)(                \
+      const text_type *T, sa_type *SA, uint64_t n) {                           \
+    return build<index_type>(T, SA, n, 1);                                     \
+  }                                                                            \
+  int GSACA_LYNDON_ENTRY(gsaca_lyndon_##text_name##_##sa_name##_par)(          \
+      const text_type *T, sa_type *SA, uint64_t n, unsigned int threads) {     \
+    return build<index_type>(T, SA, n, threads);                               \
+  }
+
+extern "C" {
+
+GSACA_LYNDON_DEFINE(u8, uint8_t, u32, uint32_t, uint32_t)
+GSACA_LYNDON_DEFINE(u8, uint8_t, u40, uint8_t, gsaca_lyndon::uint40_t)
+GSACA_LYNDON_DEFINE(u8, uint8_t, u64, uint64_t, uint64_t)
+GSACA_LYNDON_DEFINE(u16, uint16_t, u32, uint32_t, uint32_t)
+GSACA_LYNDON_DEFINE(u16, uint16_t, u40, uint8_t, gsaca_lyndon::uint40_t)
+GSACA_LYNDON_DEFINE(u16, uint16_t, u64, uint64_t, uint64_t)
+GSACA_LYNDON_DEFINE(u32, uint32_t, u32, uint32_t, uint32_t)
+GSACA_LYNDON_DEFINE(u32, uint32_t, u40, uint8_t, gsaca_lyndon::uint40_t)
+GSACA_LYNDON_DEFINE(u32, uint32_t, u64, uint64_t, uint64_t)
+
+} // extern "C"